@@ -0,0 +1,77 @@
+#include "backlinkspanel.h"
+#include "workspaceindexer.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QLabel>
+#include <QListWidget>
+#include <QVBoxLayout>
+
+BacklinksPanel::BacklinksPanel(WorkspaceIndexer *indexer, QWidget *parent)
+    : QWidget(parent)
+    , indexer(indexer)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 5, 0, 0);
+    layout->setSpacing(5);
+
+    titleLabel = new QLabel(this);
+    titleLabel->setStyleSheet("QLabel { color: #666; font-size: 10px; }");
+    layout->addWidget(titleLabel);
+
+    sourceList = new QListWidget(this);
+    sourceList->setUniformItemSizes(true);
+    connect(sourceList, &QListWidget::itemClicked, this, &BacklinksPanel::onItemActivated);
+    connect(sourceList, &QListWidget::itemActivated, this, &BacklinksPanel::onItemActivated);
+    layout->addWidget(sourceList);
+
+    connect(indexer, &WorkspaceIndexer::indexingFinished, this, &BacklinksPanel::refresh);
+}
+
+void BacklinksPanel::setFilePath(const QString &path)
+{
+    if (path == filePath) {
+        return;
+    }
+    filePath = path;
+    refresh();
+}
+
+void BacklinksPanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+}
+
+void BacklinksPanel::refresh()
+{
+    // Nothing to look up while nobody is looking
+    if (!isVisible()) {
+        return;
+    }
+
+    sourceList->clear();
+    if (filePath.isEmpty()) {
+        titleLabel->setText(tr("Backlinks: save the document first"));
+        return;
+    }
+
+    const QStringList sources = indexer->backlinks(filePath);
+    QDir root(indexer->rootPath());
+    for (const QString &source : sources) {
+        QListWidgetItem *item = new QListWidgetItem(root.relativeFilePath(source), sourceList);
+        item->setData(Qt::UserRole, source);
+        item->setToolTip(source);
+    }
+
+    QString title = tr("%1 files link to %2").arg(sources.size()).arg(QFileInfo(filePath).fileName());
+    if (indexer->isIndexing()) {
+        title += tr(", still indexing");
+    }
+    titleLabel->setText(title);
+}
+
+void BacklinksPanel::onItemActivated(QListWidgetItem *item)
+{
+    emit fileSelected(item->data(Qt::UserRole).toString());
+}
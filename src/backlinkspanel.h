@@ -0,0 +1,38 @@
+#ifndef BACKLINKSPANEL_H
+#define BACKLINKSPANEL_H
+
+#include <QWidget>
+
+class QLabel;
+class QListWidget;
+class QListWidgetItem;
+class WorkspaceIndexer;
+
+// Files in the workspace that link to the current one
+class BacklinksPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit BacklinksPanel(WorkspaceIndexer *indexer, QWidget *parent = nullptr);
+
+    void setFilePath(const QString &filePath);
+
+signals:
+    void fileSelected(const QString &filePath);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void refresh();
+    void onItemActivated(QListWidgetItem *item);
+
+private:
+    WorkspaceIndexer *indexer;
+    QString filePath;
+    QLabel *titleLabel;
+    QListWidget *sourceList;
+};
+
+#endif // BACKLINKSPANEL_H
@@ -0,0 +1,62 @@
+#include "diagnostics.h"
+
+#include <QMutexLocker>
+
+QMutex Diagnostics::mutex;
+QMap<QString, qint64> Diagnostics::counters;
+QMap<QString, Diagnostics::Timing> Diagnostics::timings;
+
+void Diagnostics::increment(const QString &counter, qint64 amount)
+{
+    QMutexLocker locker(&mutex);
+    counters[counter] += amount;
+}
+
+void Diagnostics::recordDuration(const QString &name, qint64 microseconds)
+{
+    QMutexLocker locker(&mutex);
+    Timing &timing = timings[name];
+    timing.count++;
+    timing.total += microseconds;
+    timing.maximum = qMax(timing.maximum, microseconds);
+}
+
+QString Diagnostics::report()
+{
+    QMutexLocker locker(&mutex);
+    QString text;
+
+    if (!counters.isEmpty()) {
+        text += "Counters\n";
+        for (auto it = counters.constBegin(); it != counters.constEnd(); ++it) {
+            text += QString("  %1: %2\n").arg(it.key()).arg(it.value());
+        }
+    }
+
+    if (!timings.isEmpty()) {
+        if (!text.isEmpty()) {
+            text += "\n";
+        }
+        text += "Timings (ms)\n";
+        for (auto it = timings.constBegin(); it != timings.constEnd(); ++it) {
+            const Timing &timing = it.value();
+            text += QString("  %1: %2 samples, avg %3, max %4\n")
+                .arg(it.key())
+                .arg(timing.count)
+                .arg(timing.total / 1000.0 / qMax<qint64>(1, timing.count), 0, 'f', 2)
+                .arg(timing.maximum / 1000.0, 0, 'f', 2);
+        }
+    }
+
+    if (text.isEmpty()) {
+        text = "Nothing recorded yet.\n";
+    }
+    return text;
+}
+
+void Diagnostics::reset()
+{
+    QMutexLocker locker(&mutex);
+    counters.clear();
+    timings.clear();
+}
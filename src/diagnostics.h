@@ -0,0 +1,31 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <QString>
+#include <QMap>
+#include <QMutex>
+
+// Process-wide counters and timings shown in View > Diagnostics.
+// Safe to call from any thread.
+class Diagnostics
+{
+public:
+    static void increment(const QString &counter, qint64 amount = 1);
+    static void recordDuration(const QString &name, qint64 microseconds);
+    static QString report();
+    static void reset();
+
+private:
+    struct Timing
+    {
+        qint64 count = 0;
+        qint64 total = 0;
+        qint64 maximum = 0;
+    };
+
+    static QMutex mutex;
+    static QMap<QString, qint64> counters;
+    static QMap<QString, Timing> timings;
+};
+
+#endif // DIAGNOSTICS_H
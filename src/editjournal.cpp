@@ -0,0 +1,322 @@
+#include "editjournal.h"
+#include "filedecoder.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTimer>
+#include <QUuid>
+
+namespace {
+
+const quint32 JournalMagic = 0x4d444a31;  // "MDJ1"
+const quint32 JournalVersion = 1;
+
+enum RecordType : quint8 {
+    FileCheckpoint = 1,     // file path, mtime and size of the base on disk
+    ContentCheckpoint = 2,  // full text
+    EditRecord = 3          // position, removed length, inserted text
+};
+
+// Pending records are written out at most this often
+const int FlushInterval = 1000;
+
+// Once the edits since the last checkpoint outgrow the document, a fresh
+// checkpoint is cheaper to replay than the log
+const qint64 MinCheckpointBytes = 1024 * 1024;
+
+void writeHeader(QDataStream &out, const QString &filePath)
+{
+    out.setVersion(QDataStream::Qt_6_0);
+    out << JournalMagic << JournalVersion << filePath;
+}
+
+} // namespace
+
+EditJournal::EditJournal(QTextDocument *document, QObject *parent)
+    : QObject(parent)
+    , document(document)
+    , baseOnDisk(false)
+    , lastRevision(document ? document->revision() : 0)
+    , lock(nullptr)
+    , bytesSinceCheckpoint(0)
+{
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushInterval);
+    connect(flushTimer, &QTimer::timeout, this, &EditJournal::flush);
+}
+
+EditJournal::~EditJournal()
+{
+    // Only a clean exit discards the journal; anything else leaves it for recovery
+    flush();
+    closeJournal();
+}
+
+void EditJournal::setDocument(QTextDocument *document)
+{
+    flush();
+    this->document = document;
+    lastRevision = document ? document->revision() : 0;
+}
+
+void EditJournal::reset(const QString &filePath, bool matchesDisk)
+{
+    discard();
+    this->filePath = filePath;
+    baseOnDisk = matchesDisk && !filePath.isEmpty();
+    lastRevision = document ? document->revision() : 0;
+}
+
+void EditJournal::recordChange(int position, int charsRemoved, int charsAdded)
+{
+    if (!document) {
+        return;
+    }
+
+    // Highlighting reports format-only changes through the same signal
+    int revision = document->revision();
+    if (revision == lastRevision && charsRemoved == charsAdded) {
+        return;
+    }
+    lastRevision = revision;
+
+    if (!file.isOpen()) {
+        if (!openJournal()) {
+            return;
+        }
+        if (!baseOnDisk) {
+            // Nothing on disk to start from, so the first record is the text itself
+            checkpoint();
+            return;
+        }
+    }
+
+    QString inserted;
+    if (charsAdded > 0) {
+        // Only the inserted range is read, never the whole document
+        QTextCursor cursor(document);
+        int end = qMin(position + charsAdded, document->characterCount() - 1);
+        cursor.setPosition(position);
+        cursor.setPosition(end, QTextCursor::KeepAnchor);
+        inserted = cursor.selectedText();
+        inserted.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    }
+
+    QDataStream out(&buffer, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(EditRecord) << qint32(position) << qint32(charsRemoved) << inserted;
+    bytesSinceCheckpoint += 9 + inserted.size() * 2;
+
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void EditJournal::checkpoint()
+{
+    if (!file.isOpen() || !document) {
+        return;
+    }
+
+    // Replaces the log rather than appending, so the rewrite is atomic
+    QString journalPath = file.fileName();
+    file.close();
+
+    QSaveFile saveFile(journalPath);
+    if (saveFile.open(QIODevice::WriteOnly)) {
+        QDataStream out(&saveFile);
+        writeHeader(out, filePath);
+        out << quint8(ContentCheckpoint) << document->toPlainText();
+        saveFile.commit();
+    }
+
+    buffer.clear();
+    bytesSinceCheckpoint = 0;
+    baseOnDisk = false;
+    file.open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+void EditJournal::discard()
+{
+    flushTimer->stop();
+    buffer.clear();
+    bytesSinceCheckpoint = 0;
+
+    if (file.isOpen()) {
+        QString journalPath = file.fileName();
+        closeJournal();
+        QFile::remove(journalPath);
+    }
+}
+
+void EditJournal::flush()
+{
+    if (buffer.isEmpty() || !file.isOpen()) {
+        return;
+    }
+
+    if (document && bytesSinceCheckpoint > qMax<qint64>(MinCheckpointBytes, qint64(document->characterCount()) * 2)) {
+        checkpoint();
+        return;
+    }
+
+    file.write(buffer);
+    file.flush();
+    buffer.clear();
+}
+
+bool EditJournal::openJournal()
+{
+    QString directory = journalDirectory();
+    QDir().mkpath(directory);
+
+    QString journalPath = directory + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".journal";
+
+    // Held while the journal is live, so another instance does not offer to recover it
+    lock = new QLockFile(journalPath + ".lock");
+    if (!lock->tryLock(0)) {
+        delete lock;
+        lock = nullptr;
+        return false;
+    }
+
+    file.setFileName(journalPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        closeJournal();
+        return false;
+    }
+
+    QDataStream out(&file);
+    writeHeader(out, filePath);
+    if (baseOnDisk) {
+        QFileInfo fileInfo(filePath);
+        out << quint8(FileCheckpoint) << fileInfo.lastModified().toMSecsSinceEpoch() << fileInfo.size();
+    }
+    file.flush();
+    return true;
+}
+
+void EditJournal::closeJournal()
+{
+    file.close();
+    delete lock;
+    lock = nullptr;
+}
+
+QString EditJournal::journalDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/journal";
+}
+
+QStringList EditJournal::pendingJournals()
+{
+    QDir directory(journalDirectory());
+    QStringList journals;
+    for (const QString &name : directory.entryList(QStringList() << "*.journal", QDir::Files, QDir::Time)) {
+        QString journalPath = directory.filePath(name);
+
+        // Only a lock left by a process that is gone counts as stale and is taken over
+        QLockFile lock(journalPath + ".lock");
+        lock.setStaleLockTime(0);
+        if (lock.tryLock(0)) {
+            lock.unlock();
+            journals.append(journalPath);
+        }
+    }
+    return journals;
+}
+
+bool EditJournal::replay(const QString &journalPath, Recovery *recovery, QString *error)
+{
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version >> recovery->filePath;
+    if (in.status() != QDataStream::Ok || magic != JournalMagic || version != JournalVersion) {
+        *error = QObject::tr("Unrecognized journal format");
+        return false;
+    }
+
+    bool haveBase = false;
+    QString &content = recovery->content;
+
+    // A crash can cut the last record short; everything before it still applies
+    while (!in.atEnd()) {
+        quint8 type = 0;
+        in >> type;
+
+        if (type == FileCheckpoint) {
+            qint64 modified = 0;
+            qint64 size = 0;
+            in >> modified >> size;
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+
+            QFileInfo fileInfo(recovery->filePath);
+            if (fileInfo.lastModified().toMSecsSinceEpoch() != modified || fileInfo.size() != size) {
+                *error = QObject::tr("%1 has changed on disk since the edits were made")
+                    .arg(recovery->filePath);
+                return false;
+            }
+
+            // Decoded exactly as loadFile did, so the recorded positions line up
+            if (!FileDecoder::readFile(recovery->filePath, &content, error)) {
+                return false;
+            }
+            haveBase = true;
+        } else if (type == ContentCheckpoint) {
+            QString text;
+            in >> text;
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+            content = text;
+            haveBase = true;
+        } else if (type == EditRecord) {
+            qint32 position = 0;
+            qint32 removed = 0;
+            QString inserted;
+            in >> position >> removed >> inserted;
+            if (in.status() != QDataStream::Ok || !haveBase) {
+                break;
+            }
+            if (position < 0 || position > content.size()) {
+                *error = QObject::tr("Journal does not match its base text");
+                return false;
+            }
+            // Edits touching the end of the document count its final paragraph separator
+            removed = qBound(0, removed, int(content.size()) - position);
+            content.replace(position, removed, inserted);
+        } else {
+            break;
+        }
+    }
+
+    if (!haveBase) {
+        *error = QObject::tr("Journal contains no recoverable text");
+        return false;
+    }
+    return true;
+}
+
+void EditJournal::remove(const QString &journalPath)
+{
+    QFile::remove(journalPath);
+}
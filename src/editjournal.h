@@ -0,0 +1,75 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+class QLockFile;
+class QTextDocument;
+class QTimer;
+
+// Append-only log of the edits made to a document, kept in the cache
+// directory until the document is saved or the application exits cleanly.
+// After a crash the journal is replayed to recover the unsaved text.
+//
+// The journal starts from a checkpoint: either a reference to the file on
+// disk (when the buffer matched it) or a full copy of the text. After that
+// each edit appends only the changed range, so the cost of recording an
+// edit does not depend on the document size.
+class EditJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Recovery
+    {
+        QString filePath;  // empty for an untitled document
+        QString content;
+    };
+
+    explicit EditJournal(QTextDocument *document, QObject *parent = nullptr);
+    ~EditJournal();
+
+    // The journal outlives the QTextDocument of an evicted tab; pending
+    // records are written before the document is swapped
+    void setDocument(QTextDocument *document);
+
+    // Drops the current journal and starts over for the buffer as it is now.
+    // matchesDisk tells whether the buffer equals filePath on disk.
+    void reset(const QString &filePath, bool matchesDisk = true);
+    // Called from QTextDocument::contentsChange
+    void recordChange(int position, int charsRemoved, int charsAdded);
+    // Rewrites the journal as a single copy of the current text
+    void checkpoint();
+    // Deletes the journal; the buffer no longer needs recovering
+    void discard();
+
+    // Journals left behind by instances that did not exit cleanly
+    static QStringList pendingJournals();
+    static bool replay(const QString &journalPath, Recovery *recovery, QString *error);
+    static void remove(const QString &journalPath);
+
+private slots:
+    void flush();
+
+private:
+    bool openJournal();
+    void closeJournal();
+    static QString journalDirectory();
+
+    QTextDocument *document;
+    QString filePath;
+    bool baseOnDisk;
+    int lastRevision;
+
+    QFile file;
+    QLockFile *lock;
+    QByteArray buffer;  // records not yet written
+    qint64 bytesSinceCheckpoint;
+    QTimer *flushTimer;
+};
+
+#endif // EDITJOURNAL_H
@@ -1,29 +1,128 @@
 #include "filebrowser.h"
+#include "thumbnailcache.h"
 
 #include <QVBoxLayout>
 #include <QDir>
+#include <QSortFilterProxyModel>
+#include <QUrl>
+
+namespace {
+
+// Drops ignored rows before the view sees them, so it never expands into them,
+// and puts thumbnails on image files
+class IgnoreFilterModel : public QSortFilterProxyModel
+{
+public:
+    IgnoreFilterModel(QFileSystemModel *model, IgnoreRules *rules, const bool *enabled, QObject *parent)
+        : QSortFilterProxyModel(parent)
+        , model(model)
+        , rules(rules)
+        , enabled(enabled)
+        , thumbnails(nullptr)
+    {
+        setSourceModel(model);
+    }
+
+    void refilter()
+    {
+        invalidateFilter();
+    }
+
+    void setThumbnailCache(ThumbnailCache *cache)
+    {
+        thumbnails = cache;
+    }
+
+    void thumbnailChanged(const QString &filePath)
+    {
+        QModelIndex index = mapFromSource(model->index(filePath));
+        if (index.isValid()) {
+            emit dataChanged(index, index, QList<int>() << Qt::DecorationRole << Qt::ToolTipRole);
+        }
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (thumbnails && index.column() == 0 && (role == Qt::DecorationRole || role == Qt::ToolTipRole)) {
+            // Modification time and size come from the model's own cache, not the disk
+            QModelIndex source = mapToSource(index);
+            QString filePath = model->filePath(source);
+            if (!model->isDir(source) && ThumbnailCache::isImageFile(filePath)) {
+                if (role == Qt::DecorationRole) {
+                    QIcon icon = thumbnails->icon(filePath, model->lastModified(source), model->size(source));
+                    if (!icon.isNull()) {
+                        return icon;
+                    }
+                } else {
+                    QString thumbnail = thumbnails->thumbnailPath(filePath, model->lastModified(source),
+                                                                  model->size(source));
+                    if (!thumbnail.isEmpty()) {
+                        return QString("<img src=\"%1\"><br>%2")
+                            .arg(QUrl::fromLocalFile(thumbnail).toString(), model->fileName(source).toHtmlEscaped());
+                    }
+                }
+            }
+        }
+        return QSortFilterProxyModel::data(index, role);
+    }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override
+    {
+        if (!*enabled) {
+            return true;
+        }
+        QModelIndex index = model->index(sourceRow, 0, sourceParent);
+        return !rules->isIgnored(model->filePath(index), model->isDir(index));
+    }
+
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override
+    {
+        // Folders first, like the file system model's own order
+        bool leftDir = model->isDir(left);
+        bool rightDir = model->isDir(right);
+        if (leftDir != rightDir) {
+            return leftDir;
+        }
+        return model->fileName(left).compare(model->fileName(right), Qt::CaseInsensitive) < 0;
+    }
+
+private:
+    QFileSystemModel *model;
+    IgnoreRules *rules;
+    const bool *enabled;
+    ThumbnailCache *thumbnails;
+};
+
+} // namespace
 
 FileBrowser::FileBrowser(QWidget *parent)
     : QWidget(parent)
+    , thumbnailCache(nullptr)
+    , hideIgnored(true)
+    , maxWatchedDirectories(1000)
+    , loadedDirectories(0)
 {
     QVBoxLayout *layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
 
     // Create file system model
     fileSystemModel = new QFileSystemModel(this);
+    ignoreRules.setRootPath(QDir::currentPath());
     fileSystemModel->setRootPath(QDir::currentPath());
+    connect(fileSystemModel, &QFileSystemModel::directoryLoaded, this, &FileBrowser::onDirectoryLoaded);
 
     // Set filters to show markdown and image files
-    QStringList filters;
-    filters << "*.md" << "*.markdown" << "*.png" << "*.jpg" << "*.jpeg" 
-            << "*.gif" << "*.bmp" << "*.svg" << "*.webp" << "*.ico";
-    fileSystemModel->setNameFilters(filters);
+    fileSystemModel->setNameFilters(nameFilters());
     fileSystemModel->setNameFilterDisables(false);
 
+    filterModel = new IgnoreFilterModel(fileSystemModel, &ignoreRules, &hideIgnored, this);
+
     // Create tree view
     treeView = new QTreeView(this);
-    treeView->setModel(fileSystemModel);
-    treeView->setRootIndex(fileSystemModel->index(QDir::currentPath()));
+    treeView->setModel(filterModel);
+    treeView->setRootIndex(filterModel->mapFromSource(fileSystemModel->index(QDir::currentPath())));
+    treeView->setUniformRowHeights(true);
 
     // Hide all columns except name
     treeView->setColumnHidden(1, true);  // Size
@@ -52,8 +151,14 @@ FileBrowser::~FileBrowser()
 
 void FileBrowser::setRootPath(const QString &path)
 {
+    ignoreRules.setRootPath(path);
+    loadedDirectories = 0;
+    fileSystemModel->setOption(QFileSystemModel::DontWatchForChanges, false);
+    treeView->setToolTip(QString());
+
     fileSystemModel->setRootPath(path);
-    treeView->setRootIndex(fileSystemModel->index(path));
+    static_cast<IgnoreFilterModel *>(filterModel)->refilter();
+    treeView->setRootIndex(filterModel->mapFromSource(fileSystemModel->index(path)));
 }
 
 QString FileBrowser::getRootPath() const
@@ -61,12 +166,84 @@ QString FileBrowser::getRootPath() const
     return fileSystemModel->rootPath();
 }
 
+QStringList FileBrowser::nameFilters()
+{
+    QStringList filters;
+    filters << "*.md" << "*.markdown" << "*.png" << "*.jpg" << "*.jpeg" 
+            << "*.gif" << "*.bmp" << "*.svg" << "*.webp" << "*.ico";
+    return filters;
+}
+
+void FileBrowser::setHideIgnored(bool hide)
+{
+    if (hide == hideIgnored) {
+        return;
+    }
+    hideIgnored = hide;
+    ignoreRules.reload();
+    static_cast<IgnoreFilterModel *>(filterModel)->refilter();
+}
+
+bool FileBrowser::hidesIgnored() const
+{
+    return hideIgnored;
+}
+
+void FileBrowser::setIgnorePatterns(const QStringList &patterns)
+{
+    ignoreRules.setExtraPatterns(patterns);
+    static_cast<IgnoreFilterModel *>(filterModel)->refilter();
+}
+
+void FileBrowser::setMaxWatchedDirectories(int count)
+{
+    maxWatchedDirectories = count;
+}
+
+void FileBrowser::setShowThumbnails(bool show)
+{
+    if (show == (thumbnailCache != nullptr)) {
+        return;
+    }
+
+    IgnoreFilterModel *model = static_cast<IgnoreFilterModel *>(filterModel);
+    if (show) {
+        thumbnailCache = new ThumbnailCache(this);
+        connect(thumbnailCache, &ThumbnailCache::thumbnailReady, this, &FileBrowser::onThumbnailReady);
+        treeView->setIconSize(QSize(24, 24));
+    } else {
+        delete thumbnailCache;
+        thumbnailCache = nullptr;
+        treeView->setIconSize(QSize());
+    }
+    model->setThumbnailCache(thumbnailCache);
+    treeView->viewport()->update();
+}
+
+void FileBrowser::onThumbnailReady(const QString &filePath)
+{
+    static_cast<IgnoreFilterModel *>(filterModel)->thumbnailChanged(filePath);
+}
+
+void FileBrowser::onDirectoryLoaded(const QString &path)
+{
+    Q_UNUSED(path);
+
+    // The model watches every directory it has listed
+    loadedDirectories++;
+    if (loadedDirectories == maxWatchedDirectories + 1) {
+        fileSystemModel->setOption(QFileSystemModel::DontWatchForChanges, true);
+        treeView->setToolTip(tr("Large folder: changes on disk show up after reopening it"));
+    }
+}
+
 void FileBrowser::onItemClicked(const QModelIndex &index)
 {
-    QString filePath = fileSystemModel->filePath(index);
+    QModelIndex sourceIndex = filterModel->mapToSource(index);
+    QString filePath = fileSystemModel->filePath(sourceIndex);
 
     // Only emit signal if it's a file (not a directory)
-    if (fileSystemModel->isDir(index)) {
+    if (fileSystemModel->isDir(sourceIndex)) {
         return;
     }
 
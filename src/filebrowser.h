@@ -5,6 +5,11 @@
 #include <QTreeView>
 #include <QFileSystemModel>
 
+#include "ignorerules.h"
+
+class QSortFilterProxyModel;
+class ThumbnailCache;
+
 class FileBrowser : public QWidget
 {
     Q_OBJECT
@@ -16,15 +21,39 @@ public:
     void setRootPath(const QString &path);
     QString getRootPath() const;
 
+    // Markdown and image files, the ones the browser lists
+    static QStringList nameFilters();
+
+    // Hides .gitignored paths and whatever matches the extra patterns. Hidden
+    // directories are never read, which keeps large repositories responsive.
+    void setHideIgnored(bool hide);
+    bool hidesIgnored() const;
+    void setIgnorePatterns(const QStringList &patterns);
+
+    // Past this many listed directories, changes on disk are no longer
+    // watched until the root changes; watches are a limited system resource
+    void setMaxWatchedDirectories(int count);
+
+    // Image files get a thumbnail as icon and a larger one on hover
+    void setShowThumbnails(bool show);
+
 signals:
     void fileSelected(const QString &filePath);
 
 private slots:
     void onItemClicked(const QModelIndex &index);
+    void onDirectoryLoaded(const QString &path);
+    void onThumbnailReady(const QString &filePath);
 
 private:
     QTreeView *treeView;
     QFileSystemModel *fileSystemModel;
+    QSortFilterProxyModel *filterModel;
+    ThumbnailCache *thumbnailCache;  // Null while thumbnails are off
+    IgnoreRules ignoreRules;
+    bool hideIgnored;
+    int maxWatchedDirectories;
+    int loadedDirectories;
 };
 
 #endif // FILEBROWSER_H
@@ -0,0 +1,185 @@
+#include "filedecoder.h"
+#include "diagnostics.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringConverter>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILEDECODER_SSE2
+#endif
+
+bool FileDecoder::readFile(const QString &filePath, QString *text, QString *error, Access access)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    const qint64 size = file.size();
+    QByteArray fallback;
+    const uchar *data = nullptr;
+    bool mapped = false;
+    if (size > 0) {
+        if (access == Map) {
+            data = file.map(0, size);
+            mapped = data != nullptr;
+        }
+        if (!mapped) {
+            // Copied on request, or not mappable (pipes, some network file systems)
+            fallback = file.readAll();
+            if (file.error() != QFileDevice::NoError) {
+                if (error) {
+                    *error = file.errorString();
+                }
+                return false;
+            }
+            data = reinterpret_cast<const uchar *>(fallback.constData());
+        }
+    }
+    const qint64 length = mapped ? size : fallback.size();
+
+    QStringConverter::Encoding encoding = encodingForData(
+        QByteArrayView(reinterpret_cast<const char *>(data), length));
+
+    if (encoding == QStringConverter::Utf8) {
+        qint64 offset = 0;
+        if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+            offset = 3;
+        }
+
+        // UTF-8 never needs more UTF-16 units than it has bytes
+        text->resize(length - offset);
+        qint64 written = decodeUtf8(data + offset, length - offset,
+                                    reinterpret_cast<char16_t *>(text->data()));
+        text->truncate(written);
+    } else {
+        // UTF-16/32 files are rare; take the general route
+        QStringDecoder decoder(encoding);
+        *text = decoder.decode(QByteArrayView(reinterpret_cast<const char *>(data), length));
+        text->replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    }
+
+    Diagnostics::recordDuration("File decode", timer.nsecsElapsed() / 1000);
+    Diagnostics::increment("File decode: bytes", length);
+    return true;
+}
+
+QStringConverter::Encoding FileDecoder::encodingForData(QByteArrayView head)
+{
+    auto encoding = QStringConverter::encodingForData(head.first(qMin<qsizetype>(head.size(), 4)));
+    return encoding ? *encoding : QStringConverter::Utf8;
+}
+
+qint64 FileDecoder::decodeUtf8(const uchar *data, qint64 size, char16_t *out)
+{
+    char16_t *const start = out;
+    qint64 i = 0;
+
+    while (i < size) {
+#ifdef FILEDECODER_SSE2
+        // ASCII without CR is widened 16 bytes at a time
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i carriageReturn = _mm_set1_epi8('\r');
+        while (i + 16 <= size) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            int special = _mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, carriageReturn));
+            if (special) {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8), _mm_unpackhi_epi8(chunk, zero));
+            out += 16;
+            i += 16;
+        }
+#else
+        // Same idea eight bytes at a time in a plain 64-bit word
+        while (i + 8 <= size) {
+            quint64 word;
+            std::memcpy(&word, data + i, sizeof(word));
+            const quint64 highBits = 0x8080808080808080ULL;
+            const quint64 lowBits = 0x0101010101010101ULL;
+            quint64 crBytes = word ^ (lowBits * '\r');
+            if ((word & highBits) || ((crBytes - lowBits) & ~crBytes & highBits)) {
+                break;
+            }
+            for (int k = 0; k < 8; ++k) {
+                out[k] = data[i + k];
+            }
+            out += 8;
+            i += 8;
+        }
+#endif
+        if (i >= size) {
+            break;
+        }
+
+        uchar c = data[i];
+        if (c < 0x80) {
+            if (c == '\r' && i + 1 < size && data[i + 1] == '\n') {
+                // CRLF becomes LF; the LF is written on the next step
+                ++i;
+                continue;
+            }
+            *out++ = c;
+            ++i;
+            continue;
+        }
+
+        int needed;
+        char32_t codePoint;
+        char32_t minimum;
+        if ((c & 0xE0) == 0xC0) {
+            needed = 1;
+            codePoint = c & 0x1F;
+            minimum = 0x80;
+        } else if ((c & 0xF0) == 0xE0) {
+            needed = 2;
+            codePoint = c & 0x0F;
+            minimum = 0x800;
+        } else if ((c & 0xF8) == 0xF0) {
+            needed = 3;
+            codePoint = c & 0x07;
+            minimum = 0x10000;
+        } else {
+            *out++ = QChar::ReplacementCharacter;
+            ++i;
+            continue;
+        }
+
+        bool valid = i + needed < size;
+        for (int k = 1; valid && k <= needed; ++k) {
+            uchar next = data[i + k];
+            if ((next & 0xC0) != 0x80) {
+                valid = false;
+            } else {
+                codePoint = (codePoint << 6) | (next & 0x3F);
+            }
+        }
+        if (!valid || codePoint < minimum || codePoint > 0x10FFFF
+            || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+            // Resynchronize on the next byte, as QString::fromUtf8 does
+            *out++ = QChar::ReplacementCharacter;
+            ++i;
+            continue;
+        }
+
+        if (codePoint >= 0x10000) {
+            *out++ = QChar::highSurrogate(codePoint);
+            *out++ = QChar::lowSurrogate(codePoint);
+        } else {
+            *out++ = char16_t(codePoint);
+        }
+        i += needed + 1;
+    }
+
+    return out - start;
+}
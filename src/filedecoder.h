@@ -0,0 +1,29 @@
+#ifndef FILEDECODER_H
+#define FILEDECODER_H
+
+#include <QByteArrayView>
+#include <QString>
+#include <QStringConverter>
+
+class FileDecoder
+{
+public:
+    // Files another program may be writing are copied instead of mapped:
+    // touching a mapped page past a truncated end raises SIGBUS
+    enum Access { Map, Copy };
+
+    // Reads a text file the way QTextStream in text mode would (BOM detection,
+    // UTF-8 by default, CRLF turned into LF), but decodes UTF-8 straight from
+    // the memory-mapped file into the final string in a single pass.
+    static bool readFile(const QString &filePath, QString *text, QString *error = nullptr,
+                         Access access = Map);
+
+    // The encoding named by the BOM at the start of the file, UTF-8 without one
+    static QStringConverter::Encoding encodingForData(QByteArrayView head);
+
+private:
+    // Returns the number of UTF-16 units written; out must hold at least size units
+    static qint64 decodeUtf8(const uchar *data, qint64 size, char16_t *out);
+};
+
+#endif // FILEDECODER_H
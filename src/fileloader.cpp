@@ -0,0 +1,212 @@
+#include "fileloader.h"
+#include "filedecoder.h"
+
+#include <QFile>
+#include <QSemaphore>
+#include <QStringDecoder>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+
+namespace {
+
+const qint64 ChunkSize = 256 * 1024;
+const int MaxChunksInFlight = 4;
+
+} // namespace
+
+struct FileLoader::Job
+{
+    QString filePath;
+    std::atomic<bool> cancelled{false};
+    QSemaphore freeSlots{MaxChunksInFlight};
+};
+
+FileLoader::FileLoader(QObject *parent)
+    : QObject(parent)
+    , readFinished(false)
+{
+    // Zero-interval timer: one chunk per pass, so input and paint events interleave
+    deliveryTimer = new QTimer(this);
+    deliveryTimer->setInterval(0);
+    connect(deliveryTimer, &QTimer::timeout, this, &FileLoader::deliverChunk);
+}
+
+FileLoader::~FileLoader()
+{
+    cancel();
+    for (QThread *reader : readers) {
+        reader->wait();
+        delete reader;
+    }
+}
+
+void FileLoader::start(const QString &filePath)
+{
+    cancel();
+
+    auto job = std::make_shared<Job>();
+    job->filePath = filePath;
+    currentJob = job;
+    readFinished = false;
+    readError.clear();
+
+    QThread *reader = QThread::create([this, job]() { readFile(job); });
+    connect(reader, &QThread::finished, this, [this, reader]() {
+        readers.removeOne(reader);
+        reader->deleteLater();
+    });
+    readers.append(reader);
+    reader->start();
+}
+
+void FileLoader::cancel()
+{
+    if (currentJob) {
+        currentJob->cancelled = true;
+        // Wake the reader if it is waiting for the GUI to catch up
+        currentJob->freeSlots.release(MaxChunksInFlight);
+        currentJob.reset();
+    }
+
+    pendingChunks.clear();
+    pendingProgress.clear();
+    deliveryTimer->stop();
+}
+
+bool FileLoader::isRunning() const
+{
+    return currentJob != nullptr;
+}
+
+QString FileLoader::filePath() const
+{
+    return currentJob ? currentJob->filePath : QString();
+}
+
+void FileLoader::readFile(std::shared_ptr<Job> job)
+{
+    // Runs on the reader thread; only touches the job and posts results back
+    QFile file(job->filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QString error = file.errorString();
+        QMetaObject::invokeMethod(this, [this, job, error]() {
+            onReadFinished(job, error);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    const qint64 total = qMax<qint64>(1, file.size());
+    qint64 done = 0;
+    // Chosen from the first bytes, so this agrees with FileDecoder on BOMs
+    QStringDecoder decoder;
+    bool pendingCarriageReturn = false;
+
+    while (!job->cancelled) {
+        QByteArray bytes = file.read(ChunkSize);
+        if (bytes.isEmpty()) {
+            break;
+        }
+        if (done == 0) {
+            decoder = QStringDecoder(FileDecoder::encodingForData(bytes));
+        }
+        done += bytes.size();
+
+        // The decoder is stateful, so multi-byte sequences split across reads survive
+        QString text = decoder.decode(bytes);
+        if (pendingCarriageReturn) {
+            text.prepend(QLatin1Char('\r'));
+        }
+
+        // A trailing CR may be the first half of a CRLF split across reads
+        pendingCarriageReturn = text.endsWith(QLatin1Char('\r'));
+        if (pendingCarriageReturn) {
+            text.chop(1);
+        }
+        text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+
+        // Keeps memory bounded: the reader stays at most a few chunks ahead of the editor
+        job->freeSlots.acquire();
+        if (job->cancelled) {
+            break;
+        }
+
+        int percent = int(done * 100 / total);
+        QMetaObject::invokeMethod(this, [this, job, text, percent]() {
+            onChunkRead(job, text, percent);
+        }, Qt::QueuedConnection);
+    }
+
+    if (job->cancelled) {
+        return;
+    }
+
+    if (pendingCarriageReturn) {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            onChunkRead(job, QStringLiteral("\r"), 100);
+        }, Qt::QueuedConnection);
+    }
+
+    QString error;
+    if (file.error() != QFileDevice::NoError) {
+        error = file.errorString();
+    }
+    QMetaObject::invokeMethod(this, [this, job, error]() {
+        onReadFinished(job, error);
+    }, Qt::QueuedConnection);
+}
+
+void FileLoader::onChunkRead(std::shared_ptr<Job> job, const QString &text, int percent)
+{
+    if (job != currentJob) {
+        return;
+    }
+
+    pendingChunks.enqueue(text);
+    pendingProgress.append(percent);
+    if (!deliveryTimer->isActive()) {
+        deliveryTimer->start();
+    }
+}
+
+void FileLoader::onReadFinished(std::shared_ptr<Job> job, const QString &error)
+{
+    if (job != currentJob) {
+        return;
+    }
+
+    readFinished = true;
+    readError = error;
+    if (!deliveryTimer->isActive()) {
+        deliveryTimer->start();
+    }
+}
+
+void FileLoader::deliverChunk()
+{
+    if (pendingChunks.isEmpty()) {
+        deliveryTimer->stop();
+        if (currentJob && readFinished) {
+            QString error = readError;
+            currentJob.reset();
+            if (error.isEmpty()) {
+                emit finished();
+            } else {
+                emit failed(error);
+            }
+        }
+        return;
+    }
+
+    std::shared_ptr<Job> job = currentJob;
+    QString text = pendingChunks.dequeue();
+    int percent = pendingProgress.takeFirst();
+
+    emit chunkReady(text);
+    emit progressChanged(percent);
+
+    // Let the reader continue; a slot above may have cancelled this job already
+    if (job) {
+        job->freeSlots.release();
+    }
+}
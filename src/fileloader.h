@@ -0,0 +1,51 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QObject>
+#include <QList>
+#include <QQueue>
+#include <QString>
+#include <memory>
+
+class QThread;
+class QTimer;
+
+// Reads a file on a worker thread and hands it to the GUI thread in chunks,
+// one chunk per event loop iteration so the window stays responsive.
+class FileLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileLoader(QObject *parent = nullptr);
+    ~FileLoader();
+
+    void start(const QString &filePath);
+    void cancel();
+    bool isRunning() const;
+    QString filePath() const;
+
+signals:
+    void chunkReady(const QString &text);
+    void progressChanged(int percent);
+    void finished();
+    void failed(const QString &error);
+
+private:
+    struct Job;
+
+    void readFile(std::shared_ptr<Job> job);
+    void onChunkRead(std::shared_ptr<Job> job, const QString &text, int percent);
+    void onReadFinished(std::shared_ptr<Job> job, const QString &error);
+    void deliverChunk();
+
+    std::shared_ptr<Job> currentJob;
+    QQueue<QString> pendingChunks;
+    QList<int> pendingProgress;
+    bool readFinished;
+    QString readError;
+    QTimer *deliveryTimer;
+    QList<QThread *> readers;
+};
+
+#endif // FILELOADER_H
@@ -0,0 +1,97 @@
+#include "filesaver.h"
+#include "diagnostics.h"
+#include "rendercache.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+FileSaver::FileSaver(QObject *parent)
+    : QObject(parent)
+    , queuedSaves(0)
+{
+    // A single writer keeps saves of the same file in order
+    pool.setMaxThreadCount(1);
+}
+
+FileSaver::~FileSaver()
+{
+    pool.waitForDone();
+}
+
+void FileSaver::save(const QString &filePath, const QString &content, quint64 revision)
+{
+    queuedSaves++;
+    pool.start([this, filePath, content, revision]() {
+        writeFile(filePath, content, revision);
+    });
+}
+
+bool FileSaver::isSaving() const
+{
+    return queuedSaves > 0;
+}
+
+void FileSaver::waitForFinished()
+{
+    pool.waitForDone();
+    deliverResults();
+}
+
+void FileSaver::writeFile(const QString &filePath, const QString &content, quint64 revision)
+{
+    // Runs on the pool thread
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+    result.filePath = filePath;
+    result.revision = revision;
+
+    // Written to a temporary file, flushed to disk and renamed over the target on commit
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        result.error = file.errorString();
+    } else {
+        QByteArray data = content.toUtf8();
+        if (file.write(data) != data.size()) {
+            result.error = file.errorString();
+            file.cancelWriting();
+        }
+        if (!file.commit() && result.error.isEmpty()) {
+            result.error = file.errorString();
+        }
+    }
+
+    if (result.error.isEmpty()) {
+        // Lets the file watcher recognize this write as our own
+        result.contentHash = RenderCache::contentHash(content);
+    }
+
+    result.elapsedMs = timer.elapsed();
+    Diagnostics::recordDuration("Save", timer.nsecsElapsed() / 1000);
+
+    {
+        QMutexLocker locker(&mutex);
+        results.append(result);
+    }
+    QMetaObject::invokeMethod(this, &FileSaver::deliverResults, Qt::QueuedConnection);
+}
+
+void FileSaver::deliverResults()
+{
+    QList<Result> finished;
+    {
+        QMutexLocker locker(&mutex);
+        finished.swap(results);
+    }
+
+    for (const Result &result : finished) {
+        queuedSaves--;
+        if (result.error.isEmpty()) {
+            emit saved(result.filePath, result.revision, result.elapsedMs, result.contentHash);
+        } else {
+            emit failed(result.filePath, result.error);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+// Writes snapshots of a document on a worker thread. Each save goes through
+// QSaveFile, so the target is replaced atomically and a crash mid-write
+// leaves the previous version intact. Saves run one at a time, in order.
+class FileSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileSaver(QObject *parent = nullptr);
+    ~FileSaver();
+
+    // The revision is handed back so the caller can tell whether the document
+    // changed again while the write was in progress
+    void save(const QString &filePath, const QString &content, quint64 revision);
+    bool isSaving() const;
+
+    // Blocks until queued saves are written and their signals have been emitted
+    void waitForFinished();
+
+signals:
+    // contentHash is RenderCache::contentHash of the text that was written
+    void saved(const QString &filePath, quint64 revision, qint64 elapsedMs, const QByteArray &contentHash);
+    void failed(const QString &filePath, const QString &error);
+
+private:
+    struct Result
+    {
+        QString filePath;
+        quint64 revision = 0;
+        qint64 elapsedMs = 0;
+        QByteArray contentHash;
+        QString error;
+    };
+
+    void writeFile(const QString &filePath, const QString &content, quint64 revision);
+    void deliverResults();
+
+    QThreadPool pool;
+    QMutex mutex;
+    QList<Result> results;
+    int queuedSaves;
+};
+
+#endif // FILESAVER_H
@@ -0,0 +1,193 @@
+#include "gitblame.h"
+
+#include <QDir>
+#include <QTimer>
+
+namespace {
+
+// Blamed lines kept across all files
+const int MaxCachedLines = 200000;
+
+bool isCommitHash(const QByteArray &text)
+{
+    if (text.size() != 40) {
+        return false;
+    }
+    for (char c : text) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+GitBlame::GitBlame(QObject *parent)
+    : QObject(parent)
+    , finished(MaxCachedLines)
+    , runId(0)
+    , groupLine(0)
+    , groupCount(0)
+{
+    jobQueue = new GitJobQueue(this);
+    connect(jobQueue, &GitJobQueue::outputReady, this, &GitBlame::onOutputReady);
+    connect(jobQueue, &GitJobQueue::jobFinished, this, &GitBlame::onJobFinished);
+
+    updateTimer = new QTimer(this);
+    updateTimer->setSingleShot(true);
+    updateTimer->setInterval(100);
+    connect(updateTimer, &QTimer::timeout, this, [this]() {
+        emit blameUpdated(runPath);
+    });
+}
+
+void GitBlame::setRepository(const QString &root)
+{
+    if (root == repositoryRoot) {
+        return;
+    }
+    stopRun();
+    repositoryRoot = root;
+    headCommit.clear();
+    finished.clear();
+    jobQueue->setWorkingDirectory(root);
+}
+
+void GitBlame::setHeadCommit(const QString &commit)
+{
+    // Blame of the old HEAD stays cached under its own commit
+    if (commit != headCommit) {
+        stopRun();
+        headCommit = commit;
+    }
+}
+
+QString GitBlame::cacheKey(const QString &filePath) const
+{
+    return headCommit + QLatin1Char(':') + filePath;
+}
+
+void GitBlame::request(const QString &filePath)
+{
+    if (repositoryRoot.isEmpty() || filePath.isEmpty()
+            || (runId && filePath == runPath) || finished.contains(cacheKey(filePath))) {
+        return;
+    }
+
+    QString relativePath = QDir(repositoryRoot).relativeFilePath(filePath);
+    if (relativePath.startsWith(QLatin1String("../"))) {
+        return;
+    }
+
+    stopRun();
+    runPath = filePath;
+    QString revision = headCommit.isEmpty() ? QStringLiteral("HEAD") : headCommit;
+    runId = jobQueue->enqueueStreaming("blame", QStringList() << "blame" << "--incremental"
+                                                              << revision << "--" << relativePath);
+}
+
+QVector<GitBlame::Line> GitBlame::lines(const QString &filePath) const
+{
+    if (runId && filePath == runPath) {
+        return runLines;
+    }
+    QVector<Line> *lines = finished.object(cacheKey(filePath));
+    return lines ? *lines : QVector<Line>();
+}
+
+void GitBlame::stopRun()
+{
+    if (runId) {
+        jobQueue->cancel(runId);
+    }
+    runId = 0;
+    runPath.clear();
+    runLines.clear();
+    runBuffer.clear();
+    runCommits.clear();
+    groupCommit.clear();
+    updateTimer->stop();
+}
+
+void GitBlame::onOutputReady(int id, const QByteArray &data)
+{
+    if (id != runId) {
+        return;
+    }
+
+    runBuffer += data;
+    int start = 0;
+    int end;
+    while ((end = runBuffer.indexOf('\n', start)) >= 0) {
+        parseLine(runBuffer.mid(start, end - start));
+        start = end + 1;
+    }
+    runBuffer.remove(0, start);
+
+    if (!updateTimer->isActive()) {
+        updateTimer->start();
+    }
+}
+
+void GitBlame::parseLine(const QByteArray &line)
+{
+    // Each group starts with "<commit> <original line> <final line> <count>",
+    // followed by the commit's details the first time it appears, and ends
+    // with "filename <path>"
+    int space = line.indexOf(' ');
+    QByteArray key = space < 0 ? line : line.left(space);
+    QByteArray value = space < 0 ? QByteArray() : line.mid(space + 1);
+
+    if (isCommitHash(key)) {
+        QList<QByteArray> fields = value.split(' ');
+        groupCommit = QString::fromLatin1(key);
+        groupLine = fields.size() >= 3 ? fields[1].toInt() - 1 : -1;
+        groupCount = fields.size() >= 3 ? fields[2].toInt() : 0;
+        return;
+    }
+    if (groupCommit.isEmpty()) {
+        return;
+    }
+
+    CommitInfo &info = runCommits[groupCommit];
+    if (key == "author") {
+        info.author = QString::fromUtf8(value);
+    } else if (key == "author-time") {
+        info.time = value.toLongLong();
+    } else if (key == "summary") {
+        info.summary = QString::fromUtf8(value);
+    } else if (key == "filename") {
+        if (groupLine < 0 || groupCount <= 0) {
+            return;
+        }
+        if (runLines.size() < groupLine + groupCount) {
+            runLines.resize(groupLine + groupCount);
+        }
+        Line blamed;
+        blamed.commit = groupCommit;
+        blamed.author = info.author;
+        blamed.time = info.time;
+        blamed.summary = info.summary;
+        for (int i = 0; i < groupCount; ++i) {
+            runLines[groupLine + i] = blamed;
+        }
+        groupCommit.clear();
+    }
+}
+
+void GitBlame::onJobFinished(const GitJobQueue::Result &result)
+{
+    // Cancelled runs were stopped by whoever cancelled them
+    if (result.id != runId || result.cancelled) {
+        return;
+    }
+
+    // A file not in HEAD is cached as having no lines, so it is not asked again
+    QString filePath = runPath;
+    QVector<Line> *lines = new QVector<Line>(result.succeeded ? runLines : QVector<Line>());
+    runId = 0;
+    stopRun();
+    finished.insert(cacheKey(filePath), lines, qMax(1, int(lines->size())));
+    emit blameUpdated(filePath);
+}
@@ -0,0 +1,80 @@
+#ifndef GITBLAME_H
+#define GITBLAME_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QCache>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include "gitjobqueue.h"
+
+class QTimer;
+
+// Who last changed each line of the committed version of a file. The output
+// of `git blame --incremental` is parsed as it streams in, so the first
+// lines show up long before a large file is done; finished files are kept
+// per HEAD commit.
+class GitBlame : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Line
+    {
+        QString commit;  // empty while not known yet
+        QString author;
+        qint64 time = 0;  // seconds since the epoch
+        QString summary;
+    };
+
+    explicit GitBlame(QObject *parent = nullptr);
+
+    // The top of the working tree; empty turns blame off
+    void setRepository(const QString &root);
+    void setHeadCommit(const QString &commit);
+
+    // Starts blaming filePath unless it is done or under way; a file being
+    // blamed for an earlier request is dropped
+    void request(const QString &filePath);
+    // One entry per line of the file in HEAD, as far as known
+    QVector<Line> lines(const QString &filePath) const;
+
+signals:
+    void blameUpdated(const QString &filePath);
+
+private slots:
+    void onOutputReady(int id, const QByteArray &data);
+    void onJobFinished(const GitJobQueue::Result &result);
+
+private:
+    struct CommitInfo
+    {
+        QString author;
+        qint64 time = 0;
+        QString summary;
+    };
+
+    void parseLine(const QByteArray &line);
+    void stopRun();
+    QString cacheKey(const QString &filePath) const;
+
+    QString repositoryRoot;
+    QString headCommit;
+    GitJobQueue *jobQueue;
+    QCache<QString, QVector<Line>> finished;
+    QTimer *updateTimer;  // Batches updates while output streams in
+
+    // The file being blamed
+    int runId;
+    QString runPath;
+    QVector<Line> runLines;
+    QByteArray runBuffer;
+    QHash<QString, CommitInfo> runCommits;
+    QString groupCommit;  // The group being read: its commit, first line and size
+    int groupLine;
+    int groupCount;
+};
+
+#endif // GITBLAME_H
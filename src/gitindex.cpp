@@ -0,0 +1,415 @@
+#include "gitindex.h"
+#include "ignorerules.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QtEndian>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+const int HashSize = 20;
+// Stat data, hash and flags in front of each entry's path
+const int EntryHeaderSize = 62;
+
+// The object type part of an entry's mode
+const quint32 TypeMask = 0170000;
+const quint32 RegularFile = 0100000;
+
+const quint16 StageMask = 0x3000;
+const quint16 ExtendedFlag = 0x4000;
+const quint16 SkipWorktreeFlag = 0x4000;
+const quint16 IntentToAddFlag = 0x2000;
+
+QString readTextFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+QString userConfigDirectory()
+{
+    QString xdg = qEnvironmentVariable("XDG_CONFIG_HOME");
+    return (xdg.isEmpty() ? QDir::homePath() + "/.config" : xdg) + "/git";
+}
+
+QString systemConfigPath()
+{
+    if (!qEnvironmentVariableIsEmpty("GIT_CONFIG_NOSYSTEM")) {
+        return QString();
+    }
+    QString path = qEnvironmentVariable("GIT_CONFIG_SYSTEM");
+    return path.isEmpty() ? QString("/etc/gitconfig") : path;
+}
+
+} // namespace
+
+bool GitIndex::scan(const QString &workTree, const QString &gitDirectory, const QString &scopePath,
+                    ContentCache *cache, Scan *result, QString *unsupported)
+{
+    if (!checkConfiguration(workTree, gitDirectory, unsupported)) {
+        return false;
+    }
+
+    QString scope = QDir(workTree).relativeFilePath(scopePath);
+    if (scope == QLatin1String(".")) {
+        scope.clear();
+    }
+    if (scope.startsWith(QLatin1String(".."))) {
+        *unsupported = "folder outside the repository";
+        return false;
+    }
+
+    // Mapped rather than read, so only the pages holding entries are touched
+    QVector<Entry> entries;
+    qint64 indexModified = 0;
+    QFile indexFile(gitDirectory + "/index");
+    if (indexFile.exists()) {
+        if (!indexFile.open(QIODevice::ReadOnly)) {
+            *unsupported = "index not readable";
+            return false;
+        }
+        indexModified = QFileInfo(indexFile).lastModified().toMSecsSinceEpoch();
+        uchar *data = indexFile.map(0, indexFile.size());
+        if (!data) {
+            *unsupported = "index not mappable";
+            return false;
+        }
+        bool parsed = parseIndex(data, indexFile.size(), &entries, unsupported);
+        indexFile.unmap(data);
+        if (!parsed) {
+            return false;
+        }
+        // Nested .gitattributes files are not read; git applies them
+        for (const Entry &entry : std::as_const(entries)) {
+            if (entry.path.endsWith(QLatin1String("/.gitattributes"))) {
+                *unsupported = "content attributes";
+                return false;
+            }
+        }
+    }
+    result->headCommit = readHead(gitDirectory);
+
+    QSet<QString> trackedPaths;
+    QSet<QString> trackedDirectories;
+    for (const Entry &entry : std::as_const(entries)) {
+        trackedPaths.insert(entry.path);
+        int slash = entry.path.lastIndexOf(QLatin1Char('/'));
+        while (slash > 0) {
+            QString directory = entry.path.left(slash);
+            if (trackedDirectories.contains(directory)) {
+                break;  // and so are the folders above it
+            }
+            trackedDirectories.insert(directory);
+            slash = directory.lastIndexOf(QLatin1Char('/'));
+        }
+    }
+    if (!scope.isEmpty() && !trackedDirectories.contains(scope)) {
+        // Git lists an untracked folder as one entry above the scope
+        *unsupported = "folder not tracked";
+        return false;
+    }
+    QString scopePrefix = scope.isEmpty() ? QString() : scope + QLatin1Char('/');
+
+    auto addEntry = [result](const QString &path, QChar status) {
+        GitStatus::Entry entry;
+        entry.path = path;
+        entry.indexStatus = status == QLatin1Char('?') ? status : QLatin1Char('.');
+        entry.workTreeStatus = status;
+        result->workTree.append(entry);
+    };
+
+    // Tracked files: the stat data recorded in the index says whether they
+    // can have changed; only those that might are read and hashed
+    ContentCache checked;
+    for (const Entry &entry : std::as_const(entries)) {
+        if (!entry.path.startsWith(scopePrefix) || entry.skipWorktree) {
+            continue;
+        }
+        QFileInfo info(workTree + QLatin1Char('/') + entry.path);
+        if ((entry.mode & TypeMask) != RegularFile || info.isSymLink() || info.isDir()) {
+            result->skippedPaths.insert(entry.path);
+            continue;
+        }
+        if (!info.exists()) {
+            addEntry(entry.path, QLatin1Char('D'));
+            continue;
+        }
+
+        qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        qint64 size = info.size();
+        if (quint32(size) != entry.size) {
+            addEntry(entry.path, QLatin1Char('M'));
+            continue;
+        }
+        // Written in the same instant as the index, the stat data proves nothing
+        bool racy = entry.modified >= indexModified;
+        if (modified == entry.modified && !racy) {
+            continue;
+        }
+
+        ContentCheck check = cache->value(entry.path);
+        if (check.modified != modified || check.size != size || check.indexHash != entry.hash) {
+            check.modified = modified;
+            check.size = size;
+            check.indexHash = entry.hash;
+            check.matchesIndex = blobHash(info.filePath(), size) == entry.hash;
+        }
+        checked.insert(entry.path, check);
+        if (!check.matchesIndex) {
+            addEntry(entry.path, QLatin1Char('M'));
+        }
+    }
+    *cache = checked;
+
+    // Untracked files, with folders holding nothing tracked listed as one
+    // "folder/" entry like git does
+    QStringList excludes = readTextFile(commonDirectory(gitDirectory) + "/info/exclude").split(QLatin1Char('\n'))
+        + readTextFile(userConfigDirectory() + "/ignore").split(QLatin1Char('\n'));
+    IgnoreRules ignoreRules;
+    ignoreRules.setRootPath(workTree);
+    ignoreRules.setExtraPatterns(excludes);
+
+    const QDir::Filters filters = QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot;
+    std::function<bool(const QString &)> containsFiles = [&](const QString &directory) {
+        const QFileInfoList children = QDir(directory).entryInfoList(filters);
+        for (const QFileInfo &child : children) {
+            bool isDirectory = child.isDir() && !child.isSymLink();
+            QString childPath = directory + QLatin1Char('/') + child.fileName();
+            if (ignoreRules.isIgnored(childPath, isDirectory)) {
+                continue;
+            }
+            if (!isDirectory || containsFiles(childPath)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::function<void(const QString &)> walk = [&](const QString &relativeDirectory) {
+        QString directory = relativeDirectory.isEmpty() ? workTree : workTree + QLatin1Char('/') + relativeDirectory;
+        const QFileInfoList children = QDir(directory).entryInfoList(filters, QDir::Name);
+        for (const QFileInfo &child : children) {
+            QString relativePath = relativeDirectory.isEmpty()
+                ? child.fileName() : relativeDirectory + QLatin1Char('/') + child.fileName();
+            QString childPath = workTree + QLatin1Char('/') + relativePath;
+            bool isDirectory = child.isDir() && !child.isSymLink();
+            if (ignoreRules.isIgnored(childPath, isDirectory)) {
+                continue;
+            }
+            if (!isDirectory) {
+                if (!trackedPaths.contains(relativePath)) {
+                    addEntry(relativePath, QLatin1Char('?'));
+                }
+            } else if (trackedDirectories.contains(relativePath)) {
+                walk(relativePath);
+            } else if (containsFiles(childPath)) {
+                addEntry(relativePath + QLatin1Char('/'), QLatin1Char('?'));
+            }
+        }
+    };
+    walk(scope);
+    return true;
+}
+
+bool GitIndex::parseIndex(const uchar *data, qint64 size, QVector<Entry> *entries, QString *unsupported)
+{
+    if (size < 12 + HashSize || std::memcmp(data, "DIRC", 4) != 0) {
+        *unsupported = "not an index file";
+        return false;
+    }
+    quint32 version = qFromBigEndian<quint32>(data + 4);
+    if (version < 2 || version > 4) {
+        *unsupported = QString("index version %1").arg(version);
+        return false;
+    }
+    quint32 count = qFromBigEndian<quint32>(data + 8);
+
+    // The file ends with a checksum of everything before it
+    const qint64 end = size - HashSize;
+    qint64 position = 12;
+    QByteArray previousPath;
+    entries->reserve(count);
+
+    for (quint32 i = 0; i < count; ++i) {
+        if (position + EntryHeaderSize > end) {
+            *unsupported = "truncated index";
+            return false;
+        }
+        const uchar *header = data + position;
+        quint32 mtimeSeconds = qFromBigEndian<quint32>(header + 8);
+        quint32 mtimeNanoseconds = qFromBigEndian<quint32>(header + 12);
+        quint16 flags = qFromBigEndian<quint16>(header + 60);
+
+        Entry entry;
+        entry.modified = qint64(mtimeSeconds) * 1000 + mtimeNanoseconds / 1000000;
+        entry.mode = qFromBigEndian<quint32>(header + 24);
+        entry.size = qFromBigEndian<quint32>(header + 36);
+        entry.hash = QByteArray(reinterpret_cast<const char *>(header + 40), HashSize);
+
+        if (flags & StageMask) {
+            *unsupported = "unmerged entries";
+            return false;
+        }
+
+        qint64 pathStart = position + EntryHeaderSize;
+        if (flags & ExtendedFlag) {
+            if (version < 3 || pathStart + 2 > end) {
+                *unsupported = "malformed index entry";
+                return false;
+            }
+            quint16 extendedFlags = qFromBigEndian<quint16>(data + pathStart);
+            if (extendedFlags & IntentToAddFlag) {
+                *unsupported = "intent-to-add entries";
+                return false;
+            }
+            entry.skipWorktree = extendedFlags & SkipWorktreeFlag;
+            pathStart += 2;
+        }
+
+        QByteArray path;
+        if (version == 4) {
+            // A count of bytes to drop from the end of the previous path, as
+            // git's offset varint, followed by the bytes to append
+            qint64 p = pathStart;
+            if (p >= end) {
+                *unsupported = "truncated index";
+                return false;
+            }
+            uchar c = data[p++];
+            qint64 strip = c & 0x7f;
+            while (c & 0x80) {
+                if (p >= end || strip > size) {
+                    *unsupported = "malformed index entry";
+                    return false;
+                }
+                c = data[p++];
+                strip = ((strip + 1) << 7) | (c & 0x7f);
+            }
+            const void *nul = std::memchr(data + p, 0, end - p);
+            if (!nul || strip > previousPath.size()) {
+                *unsupported = "malformed index entry";
+                return false;
+            }
+            qint64 suffixLength = static_cast<const uchar *>(nul) - (data + p);
+            path = previousPath.left(previousPath.size() - strip)
+                + QByteArray(reinterpret_cast<const char *>(data + p), suffixLength);
+            position = p + suffixLength + 1;
+        } else {
+            const void *nul = std::memchr(data + pathStart, 0, end - pathStart);
+            if (!nul) {
+                *unsupported = "truncated index";
+                return false;
+            }
+            qint64 pathLength = static_cast<const uchar *>(nul) - (data + pathStart);
+            path = QByteArray(reinterpret_cast<const char *>(data + pathStart), pathLength);
+            // Padded with 1 to 8 NULs to a multiple of 8 bytes
+            position += ((pathStart - position) + pathLength + 8) & ~qint64(7);
+        }
+
+        entry.path = QString::fromUtf8(path);
+        previousPath = path;
+        entries->append(entry);
+    }
+
+    // Extensions; a split or sparse index does not list every file itself
+    while (position + 8 <= end) {
+        QByteArray signature(reinterpret_cast<const char *>(data + position), 4);
+        if (signature == "link" || signature == "sdir") {
+            *unsupported = signature == "link" ? "split index" : "sparse index";
+            return false;
+        }
+        position += 8 + qFromBigEndian<quint32>(data + position + 4);
+    }
+    return true;
+}
+
+bool GitIndex::checkConfiguration(const QString &workTree, const QString &gitDirectory, QString *unsupported)
+{
+    // Line ending conversion and filters change what a file hashes to, and
+    // with another object format the hashes are not SHA-1
+    QString system = systemConfigPath();
+    QString config = readTextFile(gitDirectory + "/config") + QLatin1Char('\n')
+        + readTextFile(commonDirectory(gitDirectory) + "/config") + QLatin1Char('\n')
+        + readTextFile(QDir::homePath() + "/.gitconfig") + QLatin1Char('\n')
+        + readTextFile(userConfigDirectory() + "/config") + QLatin1Char('\n')
+        + (system.isEmpty() ? QString() : readTextFile(system));
+    QRegularExpression settings("^\\s*(autocrlf\\s*=\\s*(true|input)|eol\\s*=|objectformat\\s*=|excludesfile\\s*=|attributesfile\\s*=)",
+                                QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption);
+    QRegularExpressionMatch match = settings.match(config);
+    if (match.hasMatch()) {
+        *unsupported = "configuration: " + match.captured(1).trimmed();
+        return false;
+    }
+    // Included files are not followed, so they could hold any of the above
+    QRegularExpression includes("^\\s*\\[\\s*include(if)?\\b",
+                                QRegularExpression::MultilineOption | QRegularExpression::CaseInsensitiveOption);
+    if (includes.match(config).hasMatch()) {
+        *unsupported = "configuration: include";
+        return false;
+    }
+
+    QString attributes = readTextFile(workTree + "/.gitattributes") + QLatin1Char('\n')
+        + readTextFile(commonDirectory(gitDirectory) + "/info/attributes");
+    QRegularExpression conversions("\\b(text|eol|crlf|filter|ident|working-tree-encoding)\\b");
+    if (conversions.match(attributes).hasMatch()) {
+        *unsupported = "content attributes";
+        return false;
+    }
+    return true;
+}
+
+QString GitIndex::readHead(const QString &gitDirectory)
+{
+    QString head = readTextFile(gitDirectory + "/HEAD").trimmed();
+    if (!head.startsWith(QLatin1String("ref:"))) {
+        return head.size() == 40 ? head : QString();
+    }
+    QString ref = head.mid(4).trimmed();
+
+    // HEAD is per worktree, branches are shared with the main repository
+    QString common = commonDirectory(gitDirectory);
+    for (const QString &directory : {gitDirectory, common}) {
+        QString commit = readTextFile(directory + QLatin1Char('/') + ref).trimmed();
+        if (!commit.isEmpty()) {
+            return commit;
+        }
+    }
+
+    const QStringList packed = readTextFile(common + "/packed-refs").split(QLatin1Char('\n'));
+    for (const QString &line : packed) {
+        if (line.size() > 41 && line[40] == QLatin1Char(' ') && line.mid(41).trimmed() == ref) {
+            return line.left(40);
+        }
+    }
+    // An unborn branch, before the first commit
+    return QString();
+}
+
+QString GitIndex::commonDirectory(const QString &gitDirectory)
+{
+    QString common = readTextFile(gitDirectory + "/commondir").trimmed();
+    return common.isEmpty() ? gitDirectory : QDir::cleanPath(QDir(gitDirectory).absoluteFilePath(common));
+}
+
+QByteArray GitIndex::blobHash(const QString &filePath, qint64 size)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    // Git hashes the object header along with the content
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray header = "blob " + QByteArray::number(size);
+    header.append('\0');
+    hash.addData(header);
+    hash.addData(&file);
+    return hash.result();
+}
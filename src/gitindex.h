@@ -0,0 +1,67 @@
+#ifndef GITINDEX_H
+#define GITINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "gitstatus.h"
+
+// Working tree status worked out from .git/index and the files' stat data,
+// without starting git. Only the common case is covered: anything it does
+// not understand (split or sparse indexes, conflicts, line ending or filter
+// settings, SHA-256 repositories) makes scan() fail, so the caller can ask
+// git instead. Staged changes need the HEAD tree and are not looked at.
+class GitIndex
+{
+public:
+    // Files whose stat data no longer matches the index are compared by
+    // content; the outcome is kept until the file or its index entry changes
+    struct ContentCheck
+    {
+        qint64 modified = 0;  // ms since the epoch
+        qint64 size = 0;
+        QByteArray indexHash;
+        bool matchesIndex = false;
+    };
+    using ContentCache = QHash<QString, ContentCheck>;
+
+    struct Scan
+    {
+        QString headCommit;
+        // Differences between the index and the files under the scope, as
+        // status entries with workTreeStatus 'M', 'D' or '?'
+        QVector<GitStatus::Entry> workTree;
+        // Tracked paths under the scope whose state only git can tell, e.g. submodules
+        QSet<QString> skippedPaths;
+    };
+
+    // Status of the files under scopePath, a folder inside workTree. Returns
+    // false with the reason in *unsupported when git has to be asked.
+    static bool scan(const QString &workTree, const QString &gitDirectory, const QString &scopePath,
+                     ContentCache *cache, Scan *result, QString *unsupported);
+
+    // The commit HEAD points at, empty before the first commit or when unreadable
+    static QString readHead(const QString &gitDirectory);
+
+private:
+    struct Entry
+    {
+        QString path;
+        quint32 mode = 0;
+        qint64 modified = 0;  // ms since the epoch
+        quint32 size = 0;
+        QByteArray hash;
+        bool skipWorktree = false;
+    };
+
+    static bool parseIndex(const uchar *data, qint64 size, QVector<Entry> *entries, QString *unsupported);
+    static bool checkConfiguration(const QString &workTree, const QString &gitDirectory, QString *unsupported);
+    static QString commonDirectory(const QString &gitDirectory);
+    static QByteArray blobHash(const QString &filePath, qint64 size);
+};
+
+#endif // GITINDEX_H
@@ -0,0 +1,222 @@
+#include "gitjobqueue.h"
+
+#include <QTimer>
+
+GitJobQueue::GitJobQueue(QObject *parent)
+    : QObject(parent)
+    , process(nullptr)
+    , currentCancelled(false)
+    , currentTimedOut(false)
+    , nextId(1)
+{
+    timeoutTimer = new QTimer(this);
+    timeoutTimer->setSingleShot(true);
+    connect(timeoutTimer, &QTimer::timeout, this, [this]() {
+        if (process) {
+            currentTimedOut = true;
+            process->kill();
+        }
+    });
+}
+
+GitJobQueue::~GitJobQueue()
+{
+    pending.clear();
+    if (process) {
+        // Killed rather than waited for; the result has nobody left to go to
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(1000);
+    }
+}
+
+void GitJobQueue::setWorkingDirectory(const QString &path)
+{
+    // A status refresh for the old repository is of no use any more; commands
+    // the user asked for still run where they were meant to
+    if (path != workingDirectory) {
+        for (int i = pending.size() - 1; i >= 0; --i) {
+            if (pending[i].coalesce) {
+                cancel(pending[i].id);
+            }
+        }
+    }
+    workingDirectory = path;
+}
+
+int GitJobQueue::enqueue(const QString &kind, const QStringList &arguments, bool coalesce,
+                         int timeoutMs, const QByteArray &input)
+{
+    if (coalesce) {
+        for (const Job &job : std::as_const(pending)) {
+            if (job.coalesce && job.arguments == arguments && job.workingDirectory == workingDirectory) {
+                return job.id;
+            }
+        }
+    }
+
+    Job job;
+    job.id = nextId++;
+    job.kind = kind;
+    job.workingDirectory = workingDirectory;
+    job.arguments = arguments;
+    job.coalesce = coalesce;
+    job.timeoutMs = timeoutMs;
+    job.input = input;
+    pending.append(job);
+
+    // Started from the event loop, so callers can connect to the id first
+    if (!process) {
+        QTimer::singleShot(0, this, &GitJobQueue::startNext);
+    }
+    return job.id;
+}
+
+int GitJobQueue::enqueueStreaming(const QString &kind, const QStringList &arguments, int timeoutMs)
+{
+    int id = enqueue(kind, arguments, false, timeoutMs);
+    pending.last().streamOutput = true;
+    return id;
+}
+
+void GitJobQueue::cancel(int id)
+{
+    if (process && current.id == id) {
+        currentCancelled = true;
+        process->kill();
+        return;
+    }
+    for (int i = 0; i < pending.size(); ++i) {
+        if (pending[i].id == id) {
+            Result result;
+            result.id = id;
+            result.kind = pending[i].kind;
+            result.workingDirectory = pending[i].workingDirectory;
+            result.arguments = pending[i].arguments;
+            result.cancelled = true;
+            pending.removeAt(i);
+            emit jobFinished(result);
+            return;
+        }
+    }
+}
+
+void GitJobQueue::cancelAll()
+{
+    while (!pending.isEmpty()) {
+        cancel(pending.last().id);
+    }
+    if (process) {
+        cancel(current.id);
+    }
+}
+
+bool GitJobQueue::isBusy() const
+{
+    return process != nullptr || !pending.isEmpty();
+}
+
+int GitJobQueue::runningJob() const
+{
+    return process ? current.id : 0;
+}
+
+void GitJobQueue::startNext()
+{
+    if (process || pending.isEmpty()) {
+        return;
+    }
+
+    current = pending.takeFirst();
+    currentCancelled = false;
+    currentTimedOut = false;
+    errorBuffer.clear();
+    errorOutput.clear();
+
+    process = new QProcess(this);
+    process->setWorkingDirectory(current.workingDirectory);
+    connect(process, &QProcess::readyReadStandardError, this, &GitJobQueue::onReadyReadError);
+    if (current.streamOutput) {
+        connect(process, &QProcess::readyReadStandardOutput, this, [this]() {
+            emit outputReady(current.id, process->readAllStandardOutput());
+        });
+    }
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+        finishCurrent(exitCode, exitStatus == QProcess::NormalExit && exitCode == 0);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        // A crash or kill is followed by finished; a failed start is not
+        if (error == QProcess::FailedToStart) {
+            errorOutput = process->errorString();
+            finishCurrent(-1, false);
+        }
+    });
+
+    emit jobStarted(current.id, current.kind);
+    QProcess *started = process;
+    started->start("git", current.arguments);
+    if (process != started) {
+        // Failed to start, was reported and the queue moved on
+        return;
+    }
+    if (!current.input.isEmpty()) {
+        process->write(current.input);
+    }
+    process->closeWriteChannel();
+    timeoutTimer->start(current.timeoutMs);
+}
+
+void GitJobQueue::onReadyReadError()
+{
+    // Progress is redrawn with '\r'; each finished segment is one update
+    errorBuffer += process->readAllStandardError();
+    int start = 0;
+    for (int i = 0; i < errorBuffer.size(); ++i) {
+        if (errorBuffer[i] != '\r' && errorBuffer[i] != '\n') {
+            continue;
+        }
+        QString line = QString::fromUtf8(errorBuffer.mid(start, i - start)).trimmed();
+        if (!line.isEmpty()) {
+            emit progress(current.id, line);
+            if (errorBuffer[i] == '\n') {
+                errorOutput += line + QLatin1Char('\n');
+            }
+        }
+        start = i + 1;
+    }
+    errorBuffer.remove(0, start);
+}
+
+void GitJobQueue::finishCurrent(int exitCode, bool succeeded)
+{
+    if (!process) {
+        return;
+    }
+    timeoutTimer->stop();
+
+    Result result;
+    result.id = current.id;
+    result.kind = current.kind;
+    result.workingDirectory = current.workingDirectory;
+    result.arguments = current.arguments;
+    result.exitCode = exitCode;
+    result.cancelled = currentCancelled;
+    result.timedOut = currentTimedOut;
+    result.succeeded = succeeded && !currentCancelled && !currentTimedOut;
+    result.output = process->readAllStandardOutput();
+    if (current.streamOutput) {
+        if (!result.output.isEmpty() && !result.cancelled) {
+            emit outputReady(current.id, result.output);
+        }
+        result.output.clear();
+    }
+    result.errorOutput = errorOutput + QString::fromUtf8(errorBuffer + process->readAllStandardError());
+
+    process->disconnect(this);
+    process->deleteLater();
+    process = nullptr;
+
+    emit jobFinished(result);
+    startNext();
+}
@@ -0,0 +1,94 @@
+#ifndef GITJOBQUEUE_H
+#define GITJOBQUEUE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+class QTimer;
+
+// Runs git commands one after another without blocking the caller. Every
+// command is queued rather than dropped when another one is running;
+// identical queued commands marked coalescing (status refreshes) run once.
+// Jobs can be cancelled, time out, and report git's progress lines.
+class GitJobQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result
+    {
+        int id = 0;
+        QString kind;  // What the caller queued it as, e.g. "status" or "commit"
+        QString workingDirectory;
+        QStringList arguments;
+        int exitCode = -1;
+        bool succeeded = false;
+        bool cancelled = false;
+        bool timedOut = false;
+        QByteArray output;
+        QString errorOutput;
+    };
+
+    static const int DefaultTimeout = 60000;  // ms
+
+    explicit GitJobQueue(QObject *parent = nullptr);
+    ~GitJobQueue();
+
+    // Applies to jobs queued from now on; ones already queued or running keep
+    // theirs, except waiting coalescing jobs, which are dropped
+    void setWorkingDirectory(const QString &path);
+
+    // Returns the job id. A coalescing job that matches one still waiting
+    // returns that job's id instead. input is written to git's stdin.
+    int enqueue(const QString &kind, const QStringList &arguments, bool coalesce = false,
+                int timeoutMs = DefaultTimeout, const QByteArray &input = QByteArray());
+    // Output is delivered as it arrives through outputReady instead of in the result
+    int enqueueStreaming(const QString &kind, const QStringList &arguments, int timeoutMs = DefaultTimeout);
+
+    void cancel(int id);
+    void cancelAll();
+
+    bool isBusy() const;
+    int runningJob() const;  // 0 when idle
+
+signals:
+    void jobStarted(int id, const QString &kind);
+    // A progress line from git's stderr, e.g. "Receiving objects:  45% (9/20)"
+    void progress(int id, const QString &line);
+    void outputReady(int id, const QByteArray &data);
+    void jobFinished(const GitJobQueue::Result &result);
+
+private:
+    struct Job
+    {
+        int id = 0;
+        QString kind;
+        QString workingDirectory;
+        QStringList arguments;
+        bool coalesce = false;
+        bool streamOutput = false;
+        int timeoutMs = DefaultTimeout;
+        QByteArray input;
+    };
+
+    void startNext();
+    void finishCurrent(int exitCode, bool succeeded);
+    void onReadyReadError();
+
+    QString workingDirectory;
+    QList<Job> pending;
+    Job current;
+    QProcess *process;  // The running job's, null when idle
+    QTimer *timeoutTimer;
+    QByteArray errorBuffer;
+    QString errorOutput;
+    bool currentCancelled;
+    bool currentTimedOut;
+    int nextId;
+};
+
+#endif // GITJOBQUEUE_H
@@ -0,0 +1,79 @@
+#include "gitstatus.h"
+
+QVector<GitStatus::Entry> GitStatus::parsePorcelainV2(const QByteArray &output)
+{
+    QVector<Entry> entries;
+    const QList<QByteArray> records = output.split('\0');
+
+    for (int i = 0; i < records.size(); ++i) {
+        const QByteArray &record = records[i];
+        if (record.size() < 3 || record[1] != ' ') {
+            continue;
+        }
+
+        Entry entry;
+        char type = record[0];
+        int pathStart = -1;
+        if (type == '1') {
+            // 1 XY sub mH mI mW hH hI path
+            pathStart = fieldStart(record, 8);
+        } else if (type == '2') {
+            // 2 XY sub mH mI mW hH hI Xscore path, then the original path as its own record
+            pathStart = fieldStart(record, 9);
+            if (i + 1 < records.size()) {
+                entry.originalPath = QString::fromUtf8(records[++i]);
+            }
+        } else if (type == 'u') {
+            // u XY sub m1 m2 m3 mW h1 h2 h3 path
+            pathStart = fieldStart(record, 10);
+            entry.conflicted = true;
+        } else if (type == '?' || type == '!') {
+            entry.path = QString::fromUtf8(record.mid(2));
+            entry.indexStatus = QLatin1Char(type);
+            entry.workTreeStatus = QLatin1Char(type);
+            entries.append(entry);
+            continue;
+        } else {
+            // Headers such as "# branch.oid"
+            continue;
+        }
+
+        if (pathStart < 0 || record.size() < 4) {
+            continue;
+        }
+        entry.indexStatus = QLatin1Char(record[2]);
+        entry.workTreeStatus = QLatin1Char(record[3]);
+        entry.path = QString::fromUtf8(record.mid(pathStart));
+        entries.append(entry);
+    }
+    return entries;
+}
+
+QString GitStatus::headCommit(const QByteArray &output)
+{
+    static const QByteArray prefix("# branch.oid ");
+    const QList<QByteArray> records = output.split('\0');
+    for (const QByteArray &record : records) {
+        if (record.startsWith(prefix)) {
+            QByteArray oid = record.mid(prefix.size());
+            return oid == "(initial)" ? QString() : QString::fromLatin1(oid);
+        }
+        if (!record.startsWith('#')) {
+            break;  // Headers come first
+        }
+    }
+    return QString();
+}
+
+int GitStatus::fieldStart(const QByteArray &record, int count)
+{
+    int position = 0;
+    for (int field = 0; field < count; ++field) {
+        position = record.indexOf(' ', position);
+        if (position < 0) {
+            return -1;
+        }
+        position++;
+    }
+    return position;
+}
@@ -0,0 +1,40 @@
+#ifndef GITSTATUS_H
+#define GITSTATUS_H
+
+#include <QByteArray>
+#include <QChar>
+#include <QString>
+#include <QVector>
+
+// Parses the output of `git status --porcelain=v2 -z`. Paths are taken
+// verbatim, so spaces, quotes and non-ASCII names need no unescaping and
+// renames keep both paths.
+class GitStatus
+{
+public:
+    struct Entry
+    {
+        QString path;
+        QString originalPath;  // renames and copies only
+        QChar indexStatus;     // '.' unchanged, '?' untracked, '!' ignored
+        QChar workTreeStatus;
+        bool conflicted = false;
+
+        bool operator==(const Entry &other) const
+        {
+            return path == other.path && originalPath == other.originalPath
+                && indexStatus == other.indexStatus && workTreeStatus == other.workTreeStatus
+                && conflicted == other.conflicted;
+        }
+    };
+
+    static QVector<Entry> parsePorcelainV2(const QByteArray &output);
+    // The "# branch.oid" header of a --branch run; empty before the first commit
+    static QString headCommit(const QByteArray &output);
+
+private:
+    // The rest of the record after the first count fields, or -1
+    static int fieldStart(const QByteArray &record, int count);
+};
+
+#endif // GITSTATUS_H
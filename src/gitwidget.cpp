@@ -8,27 +8,74 @@
 #include <QDir>
 #include <QHeaderView>
 #include <QScrollBar>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QElapsedTimer>
+#include <atomic>
+
+#include "diagnostics.h"
+
+namespace {
+
+// Bigger selections are passed to git on stdin
+const int MaxPathArguments = 100;
+const int MaxPathArgumentsLength = 8000;
+// Changed files and their folders watched outside the git directory
+const int MaxWatchedWorkingTreePaths = 500;
+
+} // namespace
+
+struct GitWidget::IndexScanJob
+{
+    QString workTree;
+    QString gitDirectory;
+    QString scopePath;
+    GitIndex::ContentCache contentCache;
+    std::atomic<bool> cancelled{false};
+};
 
 GitWidget::GitWidget(QWidget *parent)
     : QWidget(parent)
-    , gitProcess(nullptr)
-    , autoRefreshTimer(nullptr)
+    , longJob(0)
+    , refreshPending(false)
+    , readIndexDirectly(false)
+    , repositoryStateChanged(true)
+    , haveGitStatus(false)
 {
     setupUI();
-    
-    // Auto-refresh every 2 seconds
-    autoRefreshTimer = new QTimer(this);
-    connect(autoRefreshTimer, &QTimer::timeout, this, &GitWidget::autoRefresh);
-    autoRefreshTimer->start(2000);
+
+    // Commands queue up behind each other instead of being dropped
+    jobQueue = new GitJobQueue(this);
+    connect(jobQueue, &GitJobQueue::jobStarted, this, &GitWidget::onJobStarted);
+    connect(jobQueue, &GitJobQueue::progress, this, &GitWidget::onJobProgress);
+    connect(jobQueue, &GitJobQueue::jobFinished, this, &GitWidget::onJobFinished);
+
+    // Status is refreshed when the repository or the working tree changes,
+    // not on a timer, and not at all while nobody can see the panel
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(300);
+    connect(refreshTimer, &QTimer::timeout, this, &GitWidget::onRefreshTimeout);
+
+    repositoryWatcher = new QFileSystemWatcher(this);
+    connect(repositoryWatcher, &QFileSystemWatcher::fileChanged, this, &GitWidget::onRepositoryPathChanged);
+    connect(repositoryWatcher, &QFileSystemWatcher::directoryChanged, this, &GitWidget::onRepositoryPathChanged);
+
+    indexPool.setMaxThreadCount(1);
 }
 
 GitWidget::~GitWidget()
 {
-    if (gitProcess) {
-        gitProcess->kill();
-        gitProcess->waitForFinished();
-        delete gitProcess;
+    if (indexScanJob) {
+        indexScanJob->cancelled = true;
     }
+    indexPool.clear();
+    indexPool.waitForDone();
+}
+
+void GitWidget::setReadIndexDirectly(bool enabled)
+{
+    readIndexDirectly = enabled;
 }
 
 void GitWidget::setupUI()
@@ -79,6 +126,18 @@ void GitWidget::setupUI()
     
     mainLayout->addLayout(actionLayout);
 
+    QHBoxLayout *progressLayout = new QHBoxLayout();
+    progressLabel = new QLabel(this);
+    progressLabel->setWordWrap(true);
+    progressLabel->setStyleSheet("QLabel { color: #666; font-size: 10px; }");
+    progressLabel->setVisible(false);
+    progressLayout->addWidget(progressLabel, 1);
+    cancelButton = new QPushButton("Cancel", this);
+    cancelButton->setVisible(false);
+    connect(cancelButton, &QPushButton::clicked, this, &GitWidget::cancelLongJob);
+    progressLayout->addWidget(cancelButton);
+    mainLayout->addLayout(progressLayout);
+
     // Changes section (unstaged)
     QLabel *changesLabel = new QLabel("<b>Changes</b>", this);
     mainLayout->addWidget(changesLabel);
@@ -88,10 +147,15 @@ void GitWidget::setupUI()
     changesTree->setRootIsDecorated(false);
     changesTree->setIndentation(10);
     changesTree->setMaximumHeight(200);
+    changesTree->setSelectionMode(QAbstractItemView::ExtendedSelection);
     connect(changesTree, &QTreeWidget::itemDoubleClicked, this, &GitWidget::onItemDoubleClicked);
     mainLayout->addWidget(changesTree);
     
     QHBoxLayout *changesActions = new QHBoxLayout();
+    QPushButton *stageBtn = new QPushButton("+ Stage", this);
+    stageBtn->setToolTip("Stage the selected files");
+    connect(stageBtn, &QPushButton::clicked, this, &GitWidget::stageSelected);
+    changesActions->addWidget(stageBtn);
     QPushButton *stageAllBtn = new QPushButton("+ Stage All", this);
     connect(stageAllBtn, &QPushButton::clicked, this, &GitWidget::stageAll);
     changesActions->addWidget(stageAllBtn);
@@ -107,10 +171,15 @@ void GitWidget::setupUI()
     stagedTree->setRootIsDecorated(false);
     stagedTree->setIndentation(10);
     stagedTree->setMaximumHeight(200);
+    stagedTree->setSelectionMode(QAbstractItemView::ExtendedSelection);
     connect(stagedTree, &QTreeWidget::itemDoubleClicked, this, &GitWidget::onItemDoubleClicked);
     mainLayout->addWidget(stagedTree);
     
     QHBoxLayout *stagedActions = new QHBoxLayout();
+    QPushButton *unstageBtn = new QPushButton("- Unstage", this);
+    unstageBtn->setToolTip("Unstage the selected files");
+    connect(unstageBtn, &QPushButton::clicked, this, &GitWidget::unstageSelected);
+    stagedActions->addWidget(unstageBtn);
     QPushButton *unstageAllBtn = new QPushButton("- Unstage All", this);
     connect(unstageAllBtn, &QPushButton::clicked, this, &GitWidget::unstageAll);
     stagedActions->addWidget(unstageAllBtn);
@@ -143,6 +212,34 @@ void GitWidget::setWorkingDirectory(const QString &path)
             break;
         }
     } while (dir.cdUp());
+
+    gitDirectory.clear();
+    if (foundGit) {
+        // In worktrees and submodules .git is a file pointing at the real directory
+        QFileInfo dotGit(workingDirectory + "/.git");
+        if (dotGit.isDir()) {
+            gitDirectory = dotGit.absoluteFilePath();
+        } else {
+            QFile file(dotGit.absoluteFilePath());
+            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                QString line = QString::fromUtf8(file.readLine()).trimmed();
+                if (line.startsWith("gitdir:")) {
+                    gitDirectory = QDir(workingDirectory).absoluteFilePath(line.mid(7).trimmed());
+                }
+            }
+        }
+    }
+    watchRepository();
+    headCommit.clear();
+    scopePath = startPath;
+    gitStatus.clear();
+    haveGitStatus = false;
+    indexContentCache.clear();
+    if (indexScanJob) {
+        indexScanJob->cancelled = true;
+        indexScanJob.reset();
+    }
+    emit repositoryChanged(repositoryRoot());
     
     if (foundGit) {
         workingDirLabel->setText("Working Dir: <b>" + workingDirectory + "</b>");
@@ -155,69 +252,362 @@ void GitWidget::setWorkingDirectory(const QString &path)
     }
 }
 
-void GitWidget::runGitCommand(const QStringList &arguments)
+QString GitWidget::repositoryRoot() const
+{
+    return gitDirectory.isEmpty() ? QString() : workingDirectory;
+}
+
+int GitWidget::runGitCommand(const QString &kind, const QStringList &arguments, bool coalesce,
+                             const QByteArray &input)
 {
     if (workingDirectory.isEmpty()) {
+        return 0;
+    }
+
+    // Network commands may wait on a slow remote; everything else should be quick
+    bool remote = kind == "push" || kind == "pull";
+    jobQueue->setWorkingDirectory(workingDirectory);
+    return jobQueue->enqueue(kind, arguments, coalesce, remote ? 10 * 60 * 1000 : GitJobQueue::DefaultTimeout, input);
+}
+
+void GitWidget::refreshStatus()
+{
+    // Without optional locks, status does not rewrite the index, which would
+    // wake the watcher and start the next refresh
+    refreshTimer->stop();
+    refreshPending = false;
+    repositoryStateChanged = false;
+    if (indexScanJob) {
+        indexScanJob->cancelled = true;
+        indexScanJob.reset();
+    }
+    runGitCommand("status", QStringList() << "--no-optional-locks" << "status" << "--porcelain=v2" << "--branch" << "-z", true);
+}
+
+void GitWidget::notifyFileChanged(const QString &filePath)
+{
+    if (!gitDirectory.isEmpty() && filePath.startsWith(workingDirectory + QLatin1Char('/'))) {
+        scheduleRefresh();
+    }
+}
+
+void GitWidget::scheduleRefresh()
+{
+    if (gitDirectory.isEmpty()) {
         return;
     }
 
-    if (gitProcess) {
-        if (gitProcess->state() == QProcess::Running) {
-            return;
+    // A renamed-over file drops out of the watch; pick up its replacement
+    QStringList files = repositoryWatcher->files();
+    for (const QString &path : {gitDirectory + "/index", gitDirectory + "/HEAD"}) {
+        if (!files.contains(path) && QFileInfo::exists(path)) {
+            repositoryWatcher->addPath(path);
         }
-        delete gitProcess;
     }
 
-    gitProcess = new QProcess(this);
-    gitProcess->setWorkingDirectory(workingDirectory);
-    
-    connect(gitProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &GitWidget::onProcessFinished);
-    connect(gitProcess, &QProcess::errorOccurred,
-            this, &GitWidget::onProcessError);
+    if (isRefreshSuspended()) {
+        refreshPending = true;
+        return;
+    }
+    refreshTimer->start();
+}
 
-    currentCommand = "git " + arguments.join(" ");
-    gitProcess->start("git", arguments);
+void GitWidget::onRepositoryPathChanged(const QString &path)
+{
+    // Paths in the working tree only tell about files, not the repository itself
+    if (path == gitDirectory || path.startsWith(gitDirectory + QLatin1Char('/'))) {
+        repositoryStateChanged = true;
+    }
+    scheduleRefresh();
 }
 
-void GitWidget::refreshStatus()
+void GitWidget::onRefreshTimeout()
+{
+    if (isRefreshSuspended()) {
+        refreshPending = true;
+        return;
+    }
+
+    // Only the working tree changed: the index and HEAD, and with them the
+    // staged changes from the last git status, are still current
+    if (readIndexDirectly && haveGitStatus && !repositoryStateChanged) {
+        startIndexScan();
+        return;
+    }
+    // Joins a status run still waiting in the queue, if there is one
+    refreshStatus();
+}
+
+void GitWidget::startIndexScan()
 {
-    runGitCommand(QStringList() << "status" << "--porcelain");
+    if (indexScanJob) {
+        indexScanJob->cancelled = true;
+    }
+    auto job = std::make_shared<IndexScanJob>();
+    job->workTree = workingDirectory;
+    job->gitDirectory = gitDirectory;
+    job->scopePath = scopePath;
+    job->contentCache = indexContentCache;
+    indexScanJob = job;
+
+    indexPool.start([this, job]() {
+        if (job->cancelled) {
+            return;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        GitIndex::Scan scan;
+        QString unsupported;
+        bool scanned = GitIndex::scan(job->workTree, job->gitDirectory, job->scopePath,
+                                      &job->contentCache, &scan, &unsupported);
+        Diagnostics::recordDuration("Git status from index", timer.nsecsElapsed() / 1000);
+
+        QMetaObject::invokeMethod(this, [this, job, scanned, scan, unsupported]() {
+            if (job != indexScanJob) {
+                return;
+            }
+            indexScanJob.reset();
+            indexContentCache = job->contentCache;
+            onIndexScanned(scanned, scan, unsupported);
+        }, Qt::QueuedConnection);
+    });
 }
 
-void GitWidget::autoRefresh()
+void GitWidget::onIndexScanned(bool scanned, const GitIndex::Scan &scan, const QString &unsupported)
 {
-    if (!workingDirectory.isEmpty() && (!gitProcess || gitProcess->state() != QProcess::Running)) {
+    // Anything the reader cannot vouch for goes to git
+    if (!scanned || scan.headCommit != headCommit || repositoryStateChanged) {
+        Diagnostics::increment(scanned ? QString("Git status: index fallbacks (HEAD moved)")
+                                       : "Git status: index fallbacks (" + unsupported + ")");
         refreshStatus();
+        return;
+    }
+    Diagnostics::increment("Git status: read from index");
+
+    QString scopePrefix = QDir(workingDirectory).relativeFilePath(scopePath);
+    scopePrefix = scopePrefix == "." ? QString() : scopePrefix + QLatin1Char('/');
+    auto inScope = [&](const QString &path) {
+        return path.startsWith(scopePrefix) && !scan.skippedPaths.contains(path);
+    };
+
+    // Staged changes come from git; working tree state inside the folder from the scan
+    QHash<QString, QChar> workTree;
+    for (const GitStatus::Entry &entry : scan.workTree) {
+        if (entry.workTreeStatus != QLatin1Char('?')) {
+            workTree.insert(entry.path, entry.workTreeStatus);
+        }
+    }
+
+    QVector<GitStatus::Entry> status;
+    for (GitStatus::Entry entry : std::as_const(gitStatus)) {
+        if (inScope(entry.path) && entry.indexStatus != QLatin1Char('!') && !entry.conflicted) {
+            if (entry.indexStatus == QLatin1Char('?')) {
+                continue;  // Listed afresh below
+            }
+            entry.workTreeStatus = workTree.take(entry.path);
+            if (entry.workTreeStatus.isNull()) {
+                entry.workTreeStatus = QLatin1Char('.');
+            }
+            if (entry.indexStatus == QLatin1Char('.') && entry.workTreeStatus == QLatin1Char('.')) {
+                continue;
+            }
+        }
+        status.append(entry);
+    }
+    for (const GitStatus::Entry &entry : scan.workTree) {
+        if (entry.workTreeStatus == QLatin1Char('?') || workTree.contains(entry.path)) {
+            status.append(entry);
+        }
     }
+    updateFileList(status);
 }
 
-void GitWidget::stageFile(QTreeWidgetItem *item)
+bool GitWidget::isRefreshSuspended() const
 {
-    if (!item) return;
-    QString fileName = item->data(0, Qt::UserRole).toString();
-    if (!fileName.isEmpty()) {
-        runGitCommand(QStringList() << "add" << fileName);
+    return !isVisible() || !window()->isActiveWindow();
+}
+
+void GitWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    // Activation is only reported to the window, which changes when the
+    // panel is floated; installing the filter again is harmless
+    window()->installEventFilter(this);
+    if (refreshPending) {
+        scheduleRefresh();
     }
 }
 
-void GitWidget::unstageFile(QTreeWidgetItem *item)
+bool GitWidget::eventFilter(QObject *watched, QEvent *event)
 {
-    if (!item) return;
-    QString fileName = item->data(0, Qt::UserRole).toString();
-    if (!fileName.isEmpty()) {
-        runGitCommand(QStringList() << "reset" << "HEAD" << fileName);
+    // Catch up on what changed while another window had the focus
+    if (watched == window() && event->type() == QEvent::WindowActivate && refreshPending) {
+        scheduleRefresh();
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+void GitWidget::watchRepository()
+{
+    QStringList watched = repositoryWatcher->files() + repositoryWatcher->directories();
+    if (!watched.isEmpty()) {
+        repositoryWatcher->removePaths(watched);
+    }
+    if (gitDirectory.isEmpty()) {
+        return;
+    }
+
+    workingTreeWatches.clear();
+
+    // The index and HEAD cover staging, commits and checkouts. Git replaces the
+    // index by renaming, which the directory watch sees; the top of the working
+    // tree catches new and deleted files there, and saves arrive via notifyFileChanged.
+    // watchWorkingTree adds the files git status lists.
+    QStringList paths;
+    paths << gitDirectory << gitDirectory + "/index" << gitDirectory + "/HEAD" << workingDirectory;
+    for (const QString &path : std::as_const(paths)) {
+        if (QFileInfo::exists(path)) {
+            repositoryWatcher->addPath(path);
+        }
     }
 }
 
+void GitWidget::watchWorkingTree(const QVector<GitStatus::Entry> &status)
+{
+    if (gitDirectory.isEmpty()) {
+        return;
+    }
+
+    // Listed files and their folders, so other programs' edits in subfolders
+    // are noticed; in-place edits to other files there still need a refresh
+    QSet<QString> paths;
+    for (const GitStatus::Entry &entry : status) {
+        if (entry.indexStatus == '!') {
+            continue;
+        }
+        if (paths.size() >= MaxWatchedWorkingTreePaths) {
+            break;
+        }
+        // Untracked folders are listed as "folder/"
+        QString filePath = workingDirectory + QLatin1Char('/') + entry.path;
+        if (filePath.endsWith(QLatin1Char('/'))) {
+            filePath.chop(1);
+        }
+        paths.insert(filePath);
+        paths.insert(QFileInfo(filePath).absolutePath());
+    }
+    paths.remove(workingDirectory);
+
+    QStringList removed;
+    for (const QString &path : std::as_const(workingTreeWatches)) {
+        if (!paths.contains(path)) {
+            removed.append(path);
+        }
+    }
+    if (!removed.isEmpty()) {
+        repositoryWatcher->removePaths(removed);
+    }
+
+    // Files replaced by renaming drop out of the watch and are added back here
+    QStringList watchedList = repositoryWatcher->files() + repositoryWatcher->directories();
+    QSet<QString> watched(watchedList.begin(), watchedList.end());
+    QStringList added;
+    for (const QString &path : std::as_const(paths)) {
+        if (!watched.contains(path) && QFileInfo::exists(path)) {
+            added.append(path);
+        }
+    }
+    if (!added.isEmpty()) {
+        repositoryWatcher->addPaths(added);
+    }
+    workingTreeWatches = paths;
+}
+
+QStringList GitWidget::selectedPaths(QTreeWidget *tree) const
+{
+    QStringList paths;
+    const QList<QTreeWidgetItem *> items = tree->selectedItems();
+    for (QTreeWidgetItem *item : items) {
+        QString path = item->data(0, Qt::UserRole).toString();
+        if (!path.isEmpty()) {
+            paths.append(path);
+        }
+    }
+    return paths;
+}
+
+void GitWidget::stageSelected()
+{
+    stageFiles(selectedPaths(changesTree));
+}
+
+void GitWidget::unstageSelected()
+{
+    unstageFiles(selectedPaths(stagedTree));
+}
+
+void GitWidget::stageFiles(const QStringList &paths)
+{
+    if (paths.isEmpty()) {
+        return;
+    }
+    // -A also stages deletions of the listed paths
+    runForPaths("add", QStringList() << "add" << "-A", paths);
+}
+
+void GitWidget::unstageFiles(const QStringList &paths)
+{
+    if (paths.isEmpty()) {
+        return;
+    }
+
+    // A rename is unstaged as a whole, so the old path goes too
+    QStringList allPaths = paths;
+    for (const GitStatus::Entry &entry : std::as_const(lastStatus)) {
+        if (!entry.originalPath.isEmpty() && paths.contains(entry.path)) {
+            allPaths.append(entry.originalPath);
+        }
+    }
+
+    // Before the first commit there is no HEAD to restore from
+    if (headCommit.isEmpty()) {
+        runForPaths("restore", QStringList() << "rm" << "--cached" << "-q", allPaths);
+    } else {
+        runForPaths("restore", QStringList() << "restore" << "--staged", allPaths);
+    }
+}
+
+int GitWidget::runForPaths(const QString &kind, const QStringList &arguments, const QStringList &paths)
+{
+    // Paths are taken literally, not as patterns
+    QStringList command;
+    command << "--literal-pathspecs" << arguments;
+
+    // Long lists go through stdin, clear of the command line length limit
+    int length = 0;
+    for (const QString &path : paths) {
+        length += path.size() + 1;
+    }
+    if (paths.size() <= MaxPathArguments && length <= MaxPathArgumentsLength) {
+        return runGitCommand(kind, command << "--" << paths);
+    }
+
+    QByteArray input;
+    for (const QString &path : paths) {
+        input += path.toUtf8();
+        input += '\0';
+    }
+    return runGitCommand(kind, command << "--pathspec-from-file=-" << "--pathspec-file-nul", false, input);
+}
+
 void GitWidget::stageAll()
 {
-    runGitCommand(QStringList() << "add" << "-A");
+    runGitCommand("add", QStringList() << "add" << "-A");
 }
 
 void GitWidget::unstageAll()
 {
-    runGitCommand(QStringList() << "reset" << "HEAD");
+    runGitCommand("restore", QStringList() << "reset" << "-q");
 }
 
 void GitWidget::commitChanges()
@@ -229,23 +619,23 @@ void GitWidget::commitChanges()
         return;
     }
 
-    runGitCommand(QStringList() << "commit" << "-m" << message);
+    runGitCommand("commit", QStringList() << "commit" << "-m" << message);
 }
 
 void GitWidget::pushChanges()
 {
-    runGitCommand(QStringList() << "push");
+    runGitCommand("push", QStringList() << "push" << "--progress");
 }
 
 void GitWidget::pullChanges()
 {
-    runGitCommand(QStringList() << "pull");
+    runGitCommand("pull", QStringList() << "pull" << "--progress");
 }
 
 void GitWidget::syncChanges()
 {
     // Pull then push
-    runGitCommand(QStringList() << "pull" << "--rebase");
+    runGitCommand("pull", QStringList() << "pull" << "--rebase" << "--progress");
 }
 
 void GitWidget::onItemDoubleClicked(QTreeWidgetItem *item, int column)
@@ -254,119 +644,178 @@ void GitWidget::onItemDoubleClicked(QTreeWidgetItem *item, int column)
     
     if (!item) return;
     
-    // Check which tree the item belongs to
+    // Double-clicking selects just this item, so it acts on this one file
+    QString path = item->data(0, Qt::UserRole).toString();
+    if (path.isEmpty()) {
+        return;
+    }
     if (item->treeWidget() == changesTree) {
-        stageFile(item);
+        stageFiles(QStringList() << path);
     } else if (item->treeWidget() == stagedTree) {
-        unstageFile(item);
+        unstageFiles(QStringList() << path);
     }
 }
 
-void GitWidget::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+void GitWidget::onJobStarted(int id, const QString &kind)
 {
-    if (exitStatus == QProcess::NormalExit && exitCode == 0) {
-        QString output = gitProcess->readAllStandardOutput();
-        
-        if (currentCommand.contains("status") || currentCommand.contains("porcelain")) {
-            updateFileList(output);
-        } else if (currentCommand.contains("commit")) {
-            commitMessageEdit->clear();
-            refreshStatus();
-        } else if (currentCommand.contains("add") || currentCommand.contains("reset")) {
-            refreshStatus();
-        } else if (currentCommand.contains("pull") || currentCommand.contains("push")) {
-            refreshStatus();
-        }
+    if (kind == "status" || kind == "add" || kind == "restore") {
+        return;
     }
+
+    longJob = id;
+    progressLabel->setStyleSheet("QLabel { color: #666; font-size: 10px; }");
+    progressLabel->setText("Running git " + kind + "...");
+    progressLabel->setVisible(true);
+    cancelButton->setVisible(kind != "commit");
 }
 
-void GitWidget::onProcessError(QProcess::ProcessError error)
+void GitWidget::onJobProgress(int id, const QString &line)
 {
-    Q_UNUSED(error);
-    // Silently ignore errors for auto-refresh
+    if (id == longJob) {
+        progressLabel->setText(line);
+    }
 }
 
-void GitWidget::updateFileList(const QString &statusOutput)
+void GitWidget::cancelLongJob()
 {
-    changesTree->clear();
-    stagedTree->clear();
-    
-    QStringList lines = statusOutput.split('\n', Qt::SkipEmptyParts);
-    
-    for (const QString &line : lines) {
-        if (line.length() < 3) continue;
-        
-        QString statusCode = line.left(2);
-        QString fileName = line.mid(3);
-        
-        // Parse git status codes
-        QChar indexStatus = statusCode[0];
-        QChar workTreeStatus = statusCode[1];
-        
-        QString displayText;
-        QString icon;
-        
-        // Determine file status
-        if (indexStatus == 'M' || indexStatus == 'A' || indexStatus == 'D' || indexStatus == 'R' || indexStatus == 'C') {
-            // File is staged
-            if (indexStatus == 'M') {
-                icon = "M";
-                displayText = fileName + " (Modified)";
-            } else if (indexStatus == 'A') {
-                icon = "A";
-                displayText = fileName + " (Added)";
-            } else if (indexStatus == 'D') {
-                icon = "D";
-                displayText = fileName + " (Deleted)";
-            } else if (indexStatus == 'R') {
-                icon = "R";
-                displayText = fileName + " (Renamed)";
-            } else if (indexStatus == 'C') {
-                icon = "C";
-                displayText = fileName + " (Copied)";
-            }
-            
-            QTreeWidgetItem *item = new QTreeWidgetItem(stagedTree);
-            item->setText(0, icon + "  " + displayText);
-            item->setData(0, Qt::UserRole, fileName);
-            item->setToolTip(0, "Double-click to unstage");
+    if (longJob) {
+        jobQueue->cancel(longJob);
+    }
+}
+
+void GitWidget::onJobFinished(const GitJobQueue::Result &result)
+{
+    if (result.id == longJob) {
+        longJob = 0;
+        cancelButton->setVisible(false);
+        if (result.succeeded) {
+            progressLabel->setVisible(false);
+        } else {
+            // Kept up until the next long command, so the reason can be read
+            QString reason = result.cancelled ? QString("Cancelled")
+                : result.timedOut ? QString("Timed out")
+                : result.errorOutput.trimmed();
+            progressLabel->setStyleSheet("QLabel { color: red; font-size: 10px; }");
+            progressLabel->setText("git " + result.kind + " failed: " + reason);
         }
-        
-        if (workTreeStatus == 'M' || workTreeStatus == 'D' || workTreeStatus == '?') {
-            // File has unstaged changes
-            if (workTreeStatus == 'M') {
-                icon = "M";
-                displayText = fileName + " (Modified)";
-            } else if (workTreeStatus == 'D') {
-                icon = "D";
-                displayText = fileName + " (Deleted)";
-            } else if (workTreeStatus == '?') {
-                icon = "U";
-                displayText = fileName + " (Untracked)";
+    }
+
+    if (result.kind == "status") {
+        // Failed refreshes keep the last list, and so do ones for a repository
+        // that was left while they ran
+        if (result.succeeded && result.workingDirectory == workingDirectory) {
+            // Commits, checkouts and pulls all show up as a new HEAD here
+            QString commit = GitStatus::headCommit(result.output);
+            if (commit != headCommit) {
+                headCommit = commit;
+                emit headChanged(commit);
             }
-            
-            QTreeWidgetItem *item = new QTreeWidgetItem(changesTree);
-            item->setText(0, icon + "  " + displayText);
-            item->setData(0, Qt::UserRole, fileName);
-            item->setToolTip(0, "Double-click to stage");
+            gitStatus = GitStatus::parsePorcelainV2(result.output);
+            haveGitStatus = true;
+            updateFileList(gitStatus);
         }
+        return;
     }
-    
-    // Update labels with counts
-    int changesCount = changesTree->topLevelItemCount();
-    int stagedCount = stagedTree->topLevelItemCount();
-    
-    if (changesCount == 0) {
-        QTreeWidgetItem *item = new QTreeWidgetItem(changesTree);
-        item->setText(0, "No changes");
-        item->setDisabled(true);
+    if (result.kind == "commit" && result.succeeded) {
+        commitMessageEdit->clear();
     }
-    
-    if (stagedCount == 0) {
-        QTreeWidgetItem *item = new QTreeWidgetItem(stagedTree);
-        item->setText(0, "No staged changes");
+    if (!result.cancelled) {
+        refreshStatus();
+    }
+}
+
+void GitWidget::updateFileList(const QVector<GitStatus::Entry> &status)
+{
+    watchWorkingTree(status);
+    if (status == lastStatus && (!changesItems.isEmpty() || !stagedItems.isEmpty())) {
+        return;
+    }
+    lastStatus = status;
+
+    auto describe = [](QChar code, const GitStatus::Entry &entry) {
+        QString path = entry.path;
+        switch (code.unicode()) {
+        case 'M': return "M  " + path + " (Modified)";
+        case 'T': return "T  " + path + " (Type changed)";
+        case 'A': return "A  " + path + " (Added)";
+        case 'D': return "D  " + path + " (Deleted)";
+        case 'R': return "R  " + path + " (Renamed from " + entry.originalPath + ")";
+        case 'C': return "C  " + path + " (Copied from " + entry.originalPath + ")";
+        default: return QString();
+        }
+    };
+
+    // Keyed and sorted by path
+    QMap<QString, QString> changes;
+    QMap<QString, QString> staged;
+    for (const GitStatus::Entry &entry : std::as_const(status)) {
+        if (entry.indexStatus == '!') {
+            continue;
+        }
+        if (entry.indexStatus == '?') {
+            changes.insert(entry.path, "U  " + entry.path + " (Untracked)");
+            continue;
+        }
+        if (entry.conflicted) {
+            changes.insert(entry.path, "!  " + entry.path + " (Conflict)");
+            continue;
+        }
+
+        QString stagedText = describe(entry.indexStatus, entry);
+        if (!stagedText.isEmpty()) {
+            staged.insert(entry.path, stagedText);
+        }
+        QString changedText = describe(entry.workTreeStatus, entry);
+        if (!changedText.isEmpty()) {
+            changes.insert(entry.path, changedText);
+        }
+    }
+
+    updateTree(changesTree, changesItems, changes, "No changes", "Double-click to stage");
+    updateTree(stagedTree, stagedItems, staged, "No staged changes", "Double-click to unstage");
+}
+
+void GitWidget::updateTree(QTreeWidget *tree, QHash<QString, QTreeWidgetItem *> &items,
+                           const QMap<QString, QString> &rows, const QString &emptyText, const QString &toolTip)
+{
+    // Existing items stay, so selection and scroll position survive the refresh
+    tree->setUpdatesEnabled(false);
+
+    // The placeholder is kept under the empty path
+    for (auto it = items.begin(); it != items.end();) {
+        bool keep = it.key().isEmpty() ? rows.isEmpty() : rows.contains(it.key());
+        if (keep) {
+            ++it;
+        } else {
+            delete it.value();
+            it = items.erase(it);
+        }
+    }
+    if (rows.isEmpty() && !items.contains(QString())) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(tree);
+        item->setText(0, emptyText);
         item->setDisabled(true);
+        items.insert(QString(), item);
     }
+
+    // Remaining items are already in path order, so each row is either at its
+    // position or has to be inserted there
+    int position = 0;
+    for (auto row = rows.constBegin(); row != rows.constEnd(); ++row, ++position) {
+        QTreeWidgetItem *item = items.value(row.key());
+        if (!item) {
+            item = new QTreeWidgetItem();
+            item->setData(0, Qt::UserRole, row.key());
+            item->setToolTip(0, toolTip);
+            tree->insertTopLevelItem(position, item);
+            items.insert(row.key(), item);
+        }
+        if (item->text(0) != row.value()) {
+            item->setText(0, row.value());
+        }
+    }
+
+    tree->setUpdatesEnabled(true);
 }
 
 void GitWidget::appendOutput(const QString &text, bool isError)
@@ -7,11 +7,21 @@
 #include <QLineEdit>
 #include <QListWidget>
 #include <QLabel>
-#include <QProcess>
 #include <QString>
 #include <QVBoxLayout>
 #include <QTreeWidget>
 #include <QTimer>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QThreadPool>
+#include <memory>
+
+#include "gitstatus.h"
+#include "gitjobqueue.h"
+#include "gitindex.h"
+
+class QFileSystemWatcher;
 
 class GitWidget : public QWidget
 {
@@ -22,11 +32,28 @@ public:
     ~GitWidget();
 
     void setWorkingDirectory(const QString &path);
+    // The top of the working tree, empty when not in a repository
+    QString repositoryRoot() const;
+    // Refreshes after edits in the working tree read .git/index in-process
+    // instead of running git status; git still runs when the repository changes
+    void setReadIndexDirectly(bool enabled);
+
+signals:
+    void repositoryChanged(const QString &root);
+    void headChanged(const QString &commit);
+
+public slots:
+    // A file in the working tree changed, e.g. one of ours was saved
+    void notifyFileChanged(const QString &filePath);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void refreshStatus();
-    void stageFile(QTreeWidgetItem *item);
-    void unstageFile(QTreeWidgetItem *item);
+    void stageSelected();
+    void unstageSelected();
     void stageAll();
     void unstageAll();
     void commitChanges();
@@ -34,15 +61,32 @@ private slots:
     void pullChanges();
     void syncChanges();
     void onItemDoubleClicked(QTreeWidgetItem *item, int column);
-    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
-    void onProcessError(QProcess::ProcessError error);
-    void autoRefresh();
+    void onJobStarted(int id, const QString &kind);
+    void onJobProgress(int id, const QString &line);
+    void onJobFinished(const GitJobQueue::Result &result);
+    void cancelLongJob();
+    void scheduleRefresh();
+    void onRepositoryPathChanged(const QString &path);
+    void onRefreshTimeout();
 
 private:
     void setupUI();
-    void runGitCommand(const QStringList &arguments);
+    int runGitCommand(const QString &kind, const QStringList &arguments, bool coalesce = false,
+                      const QByteArray &input = QByteArray());
+    // One git run for any number of paths
+    void stageFiles(const QStringList &paths);
+    void unstageFiles(const QStringList &paths);
+    int runForPaths(const QString &kind, const QStringList &arguments, const QStringList &paths);
+    QStringList selectedPaths(QTreeWidget *tree) const;
     void appendOutput(const QString &text, bool isError = false);
-    void updateFileList(const QString &statusOutput);
+    void updateFileList(const QVector<GitStatus::Entry> &status);
+    void startIndexScan();
+    void onIndexScanned(bool scanned, const GitIndex::Scan &scan, const QString &unsupported);
+    void updateTree(QTreeWidget *tree, QHash<QString, QTreeWidgetItem *> &items,
+                    const QMap<QString, QString> &rows, const QString &emptyText, const QString &toolTip);
+    bool isRefreshSuspended() const;
+    void watchRepository();
+    void watchWorkingTree(const QVector<GitStatus::Entry> &status);
 
     // UI Components
     QLabel *workingDirLabel;
@@ -56,12 +100,35 @@ private:
     QTreeWidget *stagedTree;
     QTreeWidgetItem *changesRoot;
     QTreeWidgetItem *stagedRoot;
-    QTimer *autoRefreshTimer;
+    QLabel *progressLabel;  // Push, pull and commit progress or their errors
+    QPushButton *cancelButton;
+    QTimer *refreshTimer;  // Debounces bursts of changes into one status run
+    QFileSystemWatcher *repositoryWatcher;
+    QSet<QString> workingTreeWatches;  // Added by watchWorkingTree
 
     // Git state
     QString workingDirectory;
-    QProcess *gitProcess;
-    QString currentCommand;
+    QString gitDirectory;  // Empty when the working directory is not in a repository
+    GitJobQueue *jobQueue;
+    int longJob;  // The push, pull or commit being shown, 0 if none
+    bool refreshPending;  // Something changed while refreshing was suspended
+    QString headCommit;
+    QString scopePath;  // The folder the panel was opened for
+
+    // In-process status; git's own status stays the base for staged changes
+    struct IndexScanJob;
+    bool readIndexDirectly;
+    bool repositoryStateChanged;  // Something under the git directory changed since git status last ran
+    bool haveGitStatus;
+    QVector<GitStatus::Entry> gitStatus;  // As git status last reported it
+    GitIndex::ContentCache indexContentCache;
+    std::shared_ptr<IndexScanJob> indexScanJob;
+    QThreadPool indexPool;
+
+    // Rows by path, so a refresh only touches the files whose status changed
+    QVector<GitStatus::Entry> lastStatus;
+    QHash<QString, QTreeWidgetItem *> changesItems;
+    QHash<QString, QTreeWidgetItem *> stagedItems;
 };
 
 #endif // GITWIDGET_H
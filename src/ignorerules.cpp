@@ -0,0 +1,205 @@
+#include "ignorerules.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+IgnoreRules::IgnoreRules()
+{
+}
+
+void IgnoreRules::setRootPath(const QString &path)
+{
+    root = QDir::cleanPath(QDir(path).absolutePath());
+    directoryRules.clear();
+}
+
+QString IgnoreRules::rootPath() const
+{
+    return root;
+}
+
+void IgnoreRules::setExtraPatterns(const QStringList &patterns)
+{
+    extraRules = parse(patterns);
+}
+
+void IgnoreRules::reload()
+{
+    directoryRules.clear();
+}
+
+bool IgnoreRules::forEachFile(const QStringList &nameFilters, const std::function<bool(const QFileInfo &)> &visit,
+                              const QString &directory)
+{
+    QStringList pending(directory.isEmpty() ? root : directory);
+    while (!pending.isEmpty()) {
+        QDir current(pending.takeLast());
+
+        // Links are not followed, so they cannot lead the walk in circles
+        const QFileInfoList subdirectories = current.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QFileInfo &subdirectory : subdirectories) {
+            if (!subdirectory.isSymLink() && !isIgnored(subdirectory.filePath(), true)) {
+                pending.append(subdirectory.filePath());
+            }
+        }
+
+        const QFileInfoList files = current.entryInfoList(nameFilters, QDir::Files);
+        for (const QFileInfo &file : files) {
+            if (!isIgnored(file.filePath(), false) && !visit(file)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool IgnoreRules::isIgnored(const QString &filePath, bool isDirectory)
+{
+    if (root.isEmpty() || !filePath.startsWith(root + QLatin1Char('/'))) {
+        return false;
+    }
+
+    QString relativePath = filePath.mid(root.size() + 1);
+    int nameStart = relativePath.lastIndexOf(QLatin1Char('/')) + 1;
+    QString name = relativePath.mid(nameStart);
+
+    // Git's own directory is never worth showing
+    if (isDirectory && name == QLatin1String(".git")) {
+        return true;
+    }
+
+    // Deeper .gitignore files override shallower ones, later lines earlier ones
+    bool ignored = match(extraRules, relativePath, name, isDirectory) == 1;
+    int result = match(rulesFor(root), relativePath, name, isDirectory);
+    if (result >= 0) {
+        ignored = result == 1;
+    }
+
+    int slash = relativePath.indexOf(QLatin1Char('/'));
+    while (slash >= 0 && slash < nameStart) {
+        QString directory = root + QLatin1Char('/') + relativePath.left(slash);
+        result = match(rulesFor(directory), relativePath.mid(slash + 1), name, isDirectory);
+        if (result >= 0) {
+            ignored = result == 1;
+        }
+        slash = relativePath.indexOf(QLatin1Char('/'), slash + 1);
+    }
+    return ignored;
+}
+
+int IgnoreRules::match(const QVector<Rule> &rules, const QString &relativePath, const QString &name,
+                       bool isDirectory)
+{
+    for (int i = rules.size() - 1; i >= 0; --i) {
+        const Rule &rule = rules[i];
+        if (rule.directoryOnly && !isDirectory) {
+            continue;
+        }
+        if (rule.pattern.match(rule.nameOnly ? name : relativePath).hasMatch()) {
+            return rule.negated ? 0 : 1;
+        }
+    }
+    return -1;
+}
+
+const QVector<IgnoreRules::Rule> &IgnoreRules::rulesFor(const QString &directory)
+{
+    auto cached = directoryRules.constFind(directory);
+    if (cached != directoryRules.constEnd()) {
+        return cached.value();
+    }
+
+    QStringList lines;
+    QFile file(directory + "/.gitignore");
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream in(&file);
+        while (!in.atEnd()) {
+            lines.append(in.readLine());
+        }
+    }
+    return directoryRules.insert(directory, parse(lines)).value();
+}
+
+QVector<IgnoreRules::Rule> IgnoreRules::parse(const QStringList &lines)
+{
+    QVector<Rule> rules;
+    for (QString line : lines) {
+        // Trailing spaces are dropped unless escaped
+        while (line.endsWith(QLatin1Char(' ')) && !line.endsWith(QLatin1String("\\ "))) {
+            line.chop(1);
+        }
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+
+        Rule rule;
+        if (line.startsWith(QLatin1Char('!'))) {
+            rule.negated = true;
+            line.remove(0, 1);
+        } else if (line.startsWith(QLatin1String("\\!")) || line.startsWith(QLatin1String("\\#"))) {
+            line.remove(0, 1);
+        }
+        if (line.endsWith(QLatin1Char('/'))) {
+            rule.directoryOnly = true;
+            line.chop(1);
+        }
+
+        // A slash anywhere but the end anchors the pattern to the .gitignore's directory
+        rule.nameOnly = !line.contains(QLatin1Char('/'));
+        if (line.startsWith(QLatin1Char('/'))) {
+            line.remove(0, 1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        rule.pattern = QRegularExpression(globToRegularExpression(line));
+        if (rule.pattern.isValid()) {
+            rules.append(rule);
+        }
+    }
+    return rules;
+}
+
+QString IgnoreRules::globToRegularExpression(const QString &glob)
+{
+    QString expression = QStringLiteral("^");
+    for (int i = 0; i < glob.size(); ++i) {
+        QChar c = glob[i];
+        if (c == QLatin1Char('*')) {
+            if (i + 1 < glob.size() && glob[i + 1] == QLatin1Char('*')) {
+                // "**/" is any number of directories, a trailing "**" everything inside
+                i++;
+                if (i + 1 < glob.size() && glob[i + 1] == QLatin1Char('/')) {
+                    i++;
+                    expression += QStringLiteral("(?:.*/)?");
+                } else {
+                    expression += QStringLiteral(".*");
+                }
+            } else {
+                expression += QStringLiteral("[^/]*");
+            }
+        } else if (c == QLatin1Char('?')) {
+            expression += QStringLiteral("[^/]");
+        } else if (c == QLatin1Char('[')) {
+            int close = glob.indexOf(QLatin1Char(']'), i + 1);
+            if (close < 0) {
+                expression += QStringLiteral("\\[");
+                continue;
+            }
+            QString set = glob.mid(i + 1, close - i - 1);
+            if (set.startsWith(QLatin1Char('!'))) {
+                set[0] = QLatin1Char('^');
+            }
+            expression += QLatin1Char('[') + set + QLatin1Char(']');
+            i = close;
+        } else if (c == QLatin1Char('\\') && i + 1 < glob.size()) {
+            expression += QRegularExpression::escape(QString(glob[++i]));
+        } else {
+            expression += QRegularExpression::escape(QString(c));
+        }
+    }
+    return expression + QLatin1Char('$');
+}
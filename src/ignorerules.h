@@ -0,0 +1,61 @@
+#ifndef IGNORERULES_H
+#define IGNORERULES_H
+
+#include <QFileInfo>
+#include <QHash>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+// Decides which paths under a folder are ignored, following the .gitignore
+// files found along the way plus a list of extra patterns in the same
+// syntax. Each directory's .gitignore is read the first time a path inside
+// it is asked about.
+class IgnoreRules
+{
+public:
+    IgnoreRules();
+
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+
+    // Checked before every .gitignore, whose matching lines win, the way git
+    // treats its exclude files
+    void setExtraPatterns(const QStringList &patterns);
+
+    // Whether the file or directory is ignored; its parent is assumed not to be
+    bool isIgnored(const QString &filePath, bool isDirectory);
+
+    // Forgets the .gitignore files read so far
+    void reload();
+
+    // Calls visit for every file under the root, or under directory inside
+    // it, whose name matches one of nameFilters, without descending into
+    // ignored directories. Returns false as soon as visit does.
+    bool forEachFile(const QStringList &nameFilters, const std::function<bool(const QFileInfo &)> &visit,
+                     const QString &directory = QString());
+
+private:
+    struct Rule
+    {
+        QRegularExpression pattern;
+        bool negated = false;
+        bool directoryOnly = false;
+        bool nameOnly = false;  // no slash: matches the name at any depth
+    };
+
+    const QVector<Rule> &rulesFor(const QString &directory);
+    static QVector<Rule> parse(const QStringList &lines);
+    static QString globToRegularExpression(const QString &glob);
+    // 1 ignored, 0 re-included, -1 no rule matched
+    static int match(const QVector<Rule> &rules, const QString &relativePath, const QString &name,
+                     bool isDirectory);
+
+    QString root;
+    QVector<Rule> extraRules;
+    QHash<QString, QVector<Rule>> directoryRules;  // per directory, from its .gitignore
+};
+
+#endif // IGNORERULES_H
@@ -0,0 +1,162 @@
+#include "imagecache.h"
+
+#include <QColor>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImageIOHandler>
+#include <QImageReader>
+#include <QRunnable>
+#include <QThread>
+
+namespace {
+
+// Cache budget in kilobytes (decoded pixels, not file size)
+const int DefaultCacheCost = 128 * 1024;
+// Bookkeeping per file is dropped wholesale beyond this many entries
+const int MaxRememberedFiles = 2000;
+
+QSize scaledToWidth(const QSize &size, int width)
+{
+    if (!size.isValid() || size.width() <= width) {
+        return size;
+    }
+    return QSize(width, qMax(1, qRound(size.height() * qreal(width) / size.width())));
+}
+
+QString cacheKey(const QFileInfo &info, int width)
+{
+    return info.absoluteFilePath() + QLatin1Char('|')
+        + QString::number(info.lastModified().toMSecsSinceEpoch()) + QLatin1Char('|')
+        + QString::number(width);
+}
+
+QString slotKey(const QString &filePath, int width)
+{
+    return filePath + QLatin1Char('|') + QString::number(width);
+}
+
+} // namespace
+
+class ImageDecodeTask : public QRunnable
+{
+public:
+    ImageDecodeTask(ImageCache *cache, const QString &key, const QString &filePath, int width)
+        : cache(cache), key(key), filePath(filePath), width(width)
+    {
+    }
+
+    void run() override
+    {
+        // Let the reader decode straight into the target size so full-resolution
+        // pixels are never held in memory (JPEG decodes at reduced scale natively)
+        QImageReader reader(filePath);
+        reader.setAutoTransform(true);
+        // The scaled size applies before the EXIF rotation, so size is the
+        // image as shown and the request is turned back for rotated ones
+        bool rotated = reader.transformation() & QImageIOHandler::TransformationRotate90;
+        QSize size = rotated ? reader.size().transposed() : reader.size();
+        if (size.isValid() && size.width() > width) {
+            QSize scaled = scaledToWidth(size, width);
+            reader.setScaledSize(rotated ? scaled.transposed() : scaled);
+        }
+        QImage image = reader.read();
+
+        ImageCache *target = cache;
+        QString key = this->key;
+        QString filePath = this->filePath;
+        int width = this->width;
+        QMetaObject::invokeMethod(target, [target, key, filePath, width, size, image]() {
+            target->onImageDecoded(key, filePath, width, size, image);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    ImageCache *cache;
+    QString key;
+    QString filePath;
+    int width;
+};
+
+ImageCache::ImageCache(QObject *parent)
+    : QObject(parent)
+{
+    cache.setMaxCost(DefaultCacheCost);
+    decodePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+ImageCache::~ImageCache()
+{
+    // Results posted by running tasks are discarded together with this object
+    decodePool.clear();
+    decodePool.waitForDone();
+}
+
+void ImageCache::setMaximumCost(int kilobytes)
+{
+    cache.setMaxCost(kilobytes);
+}
+
+QImage ImageCache::image(const QString &filePath, int width, bool *ready)
+{
+    QFileInfo info(filePath);
+    const QString key = cacheKey(info, width);
+
+    if (QImage *cached = cache.object(key)) {
+        if (ready) *ready = true;
+        return *cached;
+    }
+
+    if (failedKeys.value(slotKey(info.absoluteFilePath(), width)) == key) {
+        if (ready) *ready = true;
+        return QImage();
+    }
+
+    if (ready) *ready = false;
+    if (!pendingKeys.contains(key)) {
+        pendingKeys.insert(key);
+        decodePool.start(new ImageDecodeTask(this, key, info.absoluteFilePath(), width));
+    }
+
+    return placeholder(filePath, width);
+}
+
+void ImageCache::onImageDecoded(const QString &key, const QString &filePath, int width,
+                                const QSize &size, const QImage &image)
+{
+    pendingKeys.remove(key);
+
+    if (imageSizes.size() >= MaxRememberedFiles) {
+        imageSizes.clear();
+    }
+    if (size.isValid()) {
+        imageSizes.insert(filePath, size);
+    }
+
+    QString slot = slotKey(filePath, width);
+    if (image.isNull()) {
+        if (failedKeys.size() >= MaxRememberedFiles) {
+            failedKeys.clear();
+        }
+        failedKeys.insert(slot, key);
+    } else {
+        failedKeys.remove(slot);
+        int cost = qMax(1, int(image.sizeInBytes() / 1024));
+        cache.insert(key, new QImage(image), cost);
+    }
+
+    emit imageReady(filePath);
+}
+
+QImage ImageCache::placeholder(const QString &filePath, int width) const
+{
+    // No file access here: the size is known only for images decoded before,
+    // which covers re-renders, the case where a layout jump would show
+    QSize size = scaledToWidth(imageSizes.value(QFileInfo(filePath).absoluteFilePath()), width);
+    if (!size.isValid() || size.isEmpty()) {
+        size = QSize(qMin(width, 320), 180);
+    }
+
+    QImage image(size, QImage::Format_RGB32);
+    image.fill(QColor("#f6f8fa"));
+    return image;
+}
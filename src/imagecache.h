@@ -0,0 +1,45 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+class ImageCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ImageCache(QObject *parent = nullptr);
+    ~ImageCache();
+
+    // Returns the image downscaled to at most the given width. On a cache miss the
+    // decode is queued on the background pool and a same-sized placeholder is returned.
+    QImage image(const QString &filePath, int width, bool *ready = nullptr);
+
+    void setMaximumCost(int kilobytes);
+
+signals:
+    void imageReady(const QString &filePath);
+
+private:
+    friend class ImageDecodeTask;
+
+    void onImageDecoded(const QString &key, const QString &filePath, int width,
+                        const QSize &size, const QImage &image);
+    QImage placeholder(const QString &filePath, int width) const;
+
+    QCache<QString, QImage> cache;
+    QSet<QString> pendingKeys;
+    // Cache key of the last failed decode per file and width; a newer file replaces it
+    QHash<QString, QString> failedKeys;
+    // Full size of images decoded before, so placeholders match them without reading the file
+    QHash<QString, QSize> imageSizes;
+    QThreadPool decodePool;
+};
+
+#endif // IMAGECACHE_H
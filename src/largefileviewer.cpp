@@ -0,0 +1,412 @@
+#include "largefileviewer.h"
+#include "markdownhighlighter.h"
+
+#include <QApplication>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+// The indexer publishes line offsets after every slice it scans
+const qint64 IndexSliceSize = 8 * 1024 * 1024;
+
+// Pathological single-line files would otherwise decode the whole line per repaint
+const qint64 MaxLineBytes = 64 * 1024;
+
+} // namespace
+
+struct LargeFileViewer::IndexJob
+{
+    QString filePath;
+    qint64 size = 0;
+    std::atomic<bool> cancelled{false};
+};
+
+LargeFileViewer::LargeFileViewer(QWidget *parent)
+    : QWidget(parent)
+    , data(nullptr)
+    , size(0)
+    , indexedBytes(0)
+    , indexer(nullptr)
+{
+    view = new QPlainTextEdit(this);
+    view->setReadOnly(true);
+    view->setUndoRedoEnabled(false);
+    view->setLineWrapMode(QPlainTextEdit::NoWrap);
+    view->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+
+    // Same look as the editor
+    QFont font("Monospace", 11);
+    font.setStyleHint(QFont::TypeWriter);
+    view->setFont(font);
+    view->setTabStopDistance(4 * QFontMetrics(font).horizontalAdvance(' '));
+
+    // Highlighting only ever sees the visible window
+    highlighter = new MarkdownHighlighter(view->document());
+
+    // Scrolls through lines of the file rather than pixels of the window
+    scrollBar = new QScrollBar(Qt::Vertical, this);
+    scrollBar->setSingleStep(1);
+    connect(scrollBar, &QScrollBar::valueChanged, this, &LargeFileViewer::refreshWindow);
+
+    QHBoxLayout *layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(view);
+    layout->addWidget(scrollBar);
+
+    view->installEventFilter(this);
+    view->viewport()->installEventFilter(this);
+
+    previewTimer = new QTimer(this);
+    previewTimer->setSingleShot(true);
+    previewTimer->setInterval(100);
+    connect(previewTimer, &QTimer::timeout, this, [this]() {
+        emit windowChanged(windowText);
+    });
+
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &LargeFileViewer::onFileChanged);
+}
+
+LargeFileViewer::~LargeFileViewer()
+{
+    close();
+}
+
+bool LargeFileViewer::open(const QString &filePath, QString *errorString)
+{
+    close();
+
+    file.setFileName(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+
+    size = file.size();
+    modified = QFileInfo(file).lastModified();
+    if (size > 0) {
+        data = reinterpret_cast<const char *>(file.map(0, size));
+        if (!data) {
+            if (errorString) {
+                *errorString = file.errorString();
+            }
+            file.close();
+            size = 0;
+            return false;
+        }
+    }
+
+    lineOffsets.clear();
+    lineOffsets.append(0);
+    indexedBytes = 0;
+
+    auto job = std::make_shared<IndexJob>();
+    job->filePath = filePath;
+    job->size = size;
+    indexJob = job;
+
+    indexer = QThread::create([this, job]() { indexLines(job); });
+    indexer->start();
+
+    watcher->addPath(filePath);
+
+    scrollBar->setValue(0);
+    updateScrollRange();
+    refreshWindow();
+    return true;
+}
+
+void LargeFileViewer::onFileChanged()
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    QFileInfo info(file.fileName());
+    if (!info.exists()) {
+        // Removed files stay readable through the mapping
+        return;
+    }
+    // Replacing the file by renaming drops it from the watch
+    if (!watcher->files().contains(file.fileName())) {
+        watcher->addPath(file.fileName());
+    }
+    // Same-size rewrites still move lines around
+    if (info.size() != size || info.lastModified() != modified) {
+        reopen();
+    }
+}
+
+void LargeFileViewer::reopen()
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    QString path = file.fileName();
+    int line = scrollBar->value();
+    if (!open(path)) {
+        close();
+        return;
+    }
+    // As far as the first slice reaches; further lines are still being indexed
+    scrollBar->setValue(line);
+}
+
+void LargeFileViewer::close()
+{
+    // The indexer posts offsets for this file, so it has to stop first
+    if (indexer) {
+        indexJob->cancelled = true;
+        indexer->wait();
+        delete indexer;
+        indexer = nullptr;
+    }
+    indexJob.reset();
+
+    if (data) {
+        file.unmap(reinterpret_cast<uchar *>(const_cast<char *>(data)));
+        data = nullptr;
+    }
+    file.close();
+    size = 0;
+
+    QStringList watched = watcher->files();
+    if (!watched.isEmpty()) {
+        watcher->removePaths(watched);
+    }
+
+    lineOffsets.clear();
+    indexedBytes = 0;
+    windowText.clear();
+    previewTimer->stop();
+    view->clear();
+    scrollBar->setRange(0, 0);
+}
+
+QString LargeFileViewer::filePath() const
+{
+    return file.isOpen() ? file.fileName() : QString();
+}
+
+int LargeFileViewer::lineCount() const
+{
+    return lineOffsets.size();
+}
+
+bool LargeFileViewer::isIndexing() const
+{
+    return indexJob != nullptr;
+}
+
+void LargeFileViewer::indexLines(std::shared_ptr<IndexJob> job)
+{
+    // Runs on the indexer thread and posts offsets back. It reads through its
+    // own handle rather than the mapping: a file truncated meanwhile just
+    // reads short here, where a mapped page past the end raises SIGBUS.
+    QFile input(job->filePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            onLinesIndexed(job, QVector<qint64>(), 0, true);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    QByteArray buffer(int(qMin(job->size, IndexSliceSize)), Qt::Uninitialized);
+    qint64 position = 0;
+    while (position < job->size && !job->cancelled) {
+        qint64 wanted = qMin(job->size - position, IndexSliceSize);
+        qint64 read = input.read(buffer.data(), wanted);
+        if (read < 0) {
+            read = 0;
+        }
+        QVector<qint64> lineStarts;
+
+        const char *start = buffer.constData();
+        const char *cursor = start;
+        const char *end = start + read;
+        while (cursor < end) {
+            const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+            if (!newline) {
+                break;
+            }
+            cursor = newline + 1;
+            lineStarts.append(position + (cursor - start));
+        }
+
+        position += read;
+        // A short read means the file shrank; the watcher reopens it
+        bool done = position >= job->size || read < wanted;
+        QMetaObject::invokeMethod(this, [this, job, lineStarts, position, done]() {
+            onLinesIndexed(job, lineStarts, position, done);
+        }, Qt::QueuedConnection);
+        if (done) {
+            break;
+        }
+    }
+
+    if (job->size == 0) {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            onLinesIndexed(job, QVector<qint64>(), 0, true);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void LargeFileViewer::onLinesIndexed(std::shared_ptr<IndexJob> job, const QVector<qint64> &lineStarts,
+                                     qint64 scannedBytes, bool done)
+{
+    if (job != indexJob) {
+        return;
+    }
+
+    int previousCount = lineOffsets.size();
+    lineOffsets.append(lineStarts);
+    indexedBytes = scannedBytes;
+    updateScrollRange();
+
+    // Only repaint if the window was still short of lines
+    if (previousCount <= scrollBar->value() + visibleRows()) {
+        refreshWindow();
+    }
+
+    if (done) {
+        // Posting the last batch is the indexer's final step, so this returns at once
+        indexer->wait();
+        delete indexer;
+        indexer = nullptr;
+        indexJob.reset();
+        emit indexingProgress(100);
+        emit indexingFinished(lineOffsets.size());
+    } else {
+        emit indexingProgress(int(scannedBytes * 100 / qMax<qint64>(1, size)));
+    }
+}
+
+qint64 LargeFileViewer::lineEnd(int line) const
+{
+    if (line + 1 < lineOffsets.size()) {
+        // Excludes the newline
+        return lineOffsets[line + 1] - 1;
+    }
+    // The last line known so far ends where scanning stopped
+    return indexedBytes;
+}
+
+int LargeFileViewer::visibleRows() const
+{
+    int lineHeight = qMax(1, view->fontMetrics().lineSpacing());
+    return qMax(1, view->viewport()->height() / lineHeight);
+}
+
+void LargeFileViewer::updateScrollRange()
+{
+    int rows = visibleRows();
+    scrollBar->setPageStep(rows);
+    scrollBar->setMaximum(qMax(0, lineOffsets.size() - rows));
+}
+
+void LargeFileViewer::refreshWindow()
+{
+    if (lineOffsets.isEmpty()) {
+        return;
+    }
+
+    // The watcher reports truncation late; check before reading any pages
+    if (file.size() < size) {
+        QMetaObject::invokeMethod(this, &LargeFileViewer::reopen, Qt::QueuedConnection);
+        return;
+    }
+
+    int first = scrollBar->value();
+    int last = qMin(lineOffsets.size(), first + visibleRows());
+
+    QString text;
+    for (int line = first; line < last; ++line) {
+        qint64 start = lineOffsets[line];
+        qint64 length = qMin(lineEnd(line) - start, MaxLineBytes);
+        if (length > 0 && data[start + length - 1] == '\r') {
+            --length;
+        }
+
+        if (line > first) {
+            text += QLatin1Char('\n');
+        }
+        if (length > 0) {
+            text += QString::fromUtf8(data + start, length);
+        }
+    }
+
+    if (text == windowText) {
+        return;
+    }
+    windowText = text;
+
+    int horizontal = view->horizontalScrollBar()->value();
+    view->setPlainText(text);
+    view->horizontalScrollBar()->setValue(horizontal);
+
+    previewTimer->start();
+}
+
+bool LargeFileViewer::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == view->viewport() && event->type() == QEvent::Wheel) {
+        // Vertical wheel movement scrolls the file, not the window
+        QWheelEvent *wheelEvent = static_cast<QWheelEvent *>(event);
+        if (wheelEvent->angleDelta().y() != 0) {
+            QApplication::sendEvent(scrollBar, event);
+            return true;
+        }
+    }
+
+    if (watched == view && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key()) {
+        case Qt::Key_Up:
+            scrollBar->triggerAction(QAbstractSlider::SliderSingleStepSub);
+            return true;
+        case Qt::Key_Down:
+            scrollBar->triggerAction(QAbstractSlider::SliderSingleStepAdd);
+            return true;
+        case Qt::Key_PageUp:
+            scrollBar->triggerAction(QAbstractSlider::SliderPageStepSub);
+            return true;
+        case Qt::Key_PageDown:
+            scrollBar->triggerAction(QAbstractSlider::SliderPageStepAdd);
+            return true;
+        case Qt::Key_Home:
+            if (keyEvent->modifiers() & Qt::ControlModifier) {
+                scrollBar->triggerAction(QAbstractSlider::SliderToMinimum);
+                return true;
+            }
+            break;
+        case Qt::Key_End:
+            if (keyEvent->modifiers() & Qt::ControlModifier) {
+                scrollBar->triggerAction(QAbstractSlider::SliderToMaximum);
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    return QWidget::eventFilter(watched, event);
+}
+
+void LargeFileViewer::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    updateScrollRange();
+    refreshWindow();
+}
@@ -0,0 +1,81 @@
+#ifndef LARGEFILEVIEWER_H
+#define LARGEFILEVIEWER_H
+
+#include <QWidget>
+#include <QDateTime>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+class QFileSystemWatcher;
+class QPlainTextEdit;
+class QScrollBar;
+class QThread;
+class QTimer;
+class MarkdownHighlighter;
+
+// Read-only view of a file too large for the editor. A line-offset index is
+// built in the background by reading the file in slices, and only the lines
+// that fit in the viewport are decoded, from a memory mapping, and highlighted.
+class LargeFileViewer : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileViewer(QWidget *parent = nullptr);
+    ~LargeFileViewer();
+
+    bool open(const QString &filePath, QString *errorString = nullptr);
+    void close();
+
+    QString filePath() const;
+    int lineCount() const;
+    bool isIndexing() const;
+
+signals:
+    void indexingProgress(int percent);
+    void indexingFinished(int lineCount);
+    // The visible lines, debounced, for rendering a preview of just this part
+    void windowChanged(const QString &text);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    struct IndexJob;
+
+    void indexLines(std::shared_ptr<IndexJob> job);
+    void onLinesIndexed(std::shared_ptr<IndexJob> job, const QVector<qint64> &lineStarts,
+                        qint64 scannedBytes, bool done);
+    void refreshWindow();
+    // Maps the file again after another program changed its size
+    void reopen();
+    void onFileChanged();
+    void updateScrollRange();
+    int visibleRows() const;
+    qint64 lineEnd(int line) const;
+
+    QPlainTextEdit *view;
+    QScrollBar *scrollBar;
+    MarkdownHighlighter *highlighter;
+    QTimer *previewTimer;
+
+    QFile file;
+    const char *data;
+    qint64 size;
+    QDateTime modified;
+    // Touching mapped pages past the end of a truncated file raises SIGBUS
+    QFileSystemWatcher *watcher;
+
+    // Start offset of every line indexed so far; the first line starts at 0
+    QVector<qint64> lineOffsets;
+    qint64 indexedBytes;
+    std::shared_ptr<IndexJob> indexJob;
+    QThread *indexer;
+
+    QString windowText;
+};
+
+#endif // LARGEFILEVIEWER_H
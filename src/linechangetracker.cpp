@@ -0,0 +1,187 @@
+#include "linechangetracker.h"
+#include "diagnostics.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <atomic>
+
+namespace {
+
+// Committed lines kept across all files
+const int MaxCachedLines = 200000;
+// Beyond this many differing lines the middle is marked as one change
+const int MaxEditDistance = 1000;
+
+QStringList splitLines(const QString &text)
+{
+    QStringList lines = text.split(QLatin1Char('\n'));
+    for (QString &line : lines) {
+        if (line.endsWith(QLatin1Char('\r'))) {
+            line.chop(1);
+        }
+    }
+    return lines;
+}
+
+} // namespace
+
+struct LineChangeTracker::DiffJob
+{
+    QString filePath;
+    QStringList oldLines;
+    QString text;
+    std::atomic<bool> cancelled{false};
+};
+
+LineChangeTracker::LineChangeTracker(QObject *parent)
+    : QObject(parent)
+    , bases(MaxCachedLines)
+{
+    pool.setMaxThreadCount(1);
+
+    jobQueue = new GitJobQueue(this);
+    connect(jobQueue, &GitJobQueue::jobFinished, this, &LineChangeTracker::onBaseFetched);
+}
+
+LineChangeTracker::~LineChangeTracker()
+{
+    if (diffJob) {
+        diffJob->cancelled = true;
+    }
+    pool.clear();
+    pool.waitForDone();
+}
+
+void LineChangeTracker::setRepository(const QString &root)
+{
+    if (root == repositoryRoot) {
+        return;
+    }
+    repositoryRoot = root;
+    headCommit.clear();
+    clearBases();
+    jobQueue->setWorkingDirectory(root);
+}
+
+void LineChangeTracker::setHeadCommit(const QString &commit)
+{
+    if (commit == headCommit) {
+        return;
+    }
+    // The committed text of every file may have changed
+    headCommit = commit;
+    clearBases();
+}
+
+void LineChangeTracker::clearBases()
+{
+    bases.clear();
+    fetching.clear();
+    jobQueue->cancelAll();
+    if (diffJob) {
+        diffJob->cancelled = true;
+        diffJob.reset();
+    }
+}
+
+void LineChangeTracker::update(const QString &filePath, const QString &text)
+{
+    pendingPath = filePath;
+    pendingText = text;
+
+    if (repositoryRoot.isEmpty() || filePath.isEmpty()) {
+        emit changesReady(filePath, QVector<LineDiff::Hunk>());
+        return;
+    }
+
+    if (bases.contains(filePath)) {
+        startDiff();
+        return;
+    }
+    for (const QString &path : std::as_const(fetching)) {
+        if (path == filePath) {
+            return;
+        }
+    }
+
+    QString relativePath = QDir(repositoryRoot).relativeFilePath(filePath);
+    if (relativePath.startsWith(QLatin1String("../"))) {
+        bases.insert(filePath, new Base, 1);
+        startDiff();
+        return;
+    }
+
+    QString revision = headCommit.isEmpty() ? QStringLiteral("HEAD") : headCommit;
+    int id = jobQueue->enqueue("show", QStringList() << "show" << revision + QLatin1Char(':') + relativePath);
+    fetching.insert(id, filePath);
+}
+
+void LineChangeTracker::onBaseFetched(const GitJobQueue::Result &result)
+{
+    QString filePath = fetching.take(result.id);
+    if (filePath.isEmpty() || result.cancelled) {
+        return;
+    }
+
+    // A failure means the file is not in HEAD, e.g. it is new
+    Base *base = new Base;
+    base->tracked = result.succeeded;
+    if (base->tracked) {
+        base->lines = splitLines(QString::fromUtf8(result.output));
+        if (base->lines.size() > MaxDiffLines) {
+            base->tracked = false;
+            base->lines.clear();
+        }
+    }
+    bases.insert(filePath, base, qMax(1, int(base->lines.size())));
+
+    if (filePath == pendingPath) {
+        startDiff();
+    }
+}
+
+void LineChangeTracker::startDiff()
+{
+    Base *base = bases.object(pendingPath);
+    if (!base || !base->tracked) {
+        emit changesReady(pendingPath, QVector<LineDiff::Hunk>());
+        return;
+    }
+
+    if (diffJob) {
+        diffJob->cancelled = true;
+    }
+    auto job = std::make_shared<DiffJob>();
+    job->filePath = pendingPath;
+    job->oldLines = base->lines;
+    job->text = pendingText;
+    diffJob = job;
+
+    pool.start([this, job]() { diff(job); });
+}
+
+void LineChangeTracker::diff(std::shared_ptr<DiffJob> job)
+{
+    // Runs on the pool thread
+    if (job->cancelled) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<LineDiff::Hunk> hunks;
+    QStringList newLines = splitLines(job->text);
+    if (newLines.size() <= MaxDiffLines) {
+        hunks = LineDiff::diff(job->oldLines, newLines, MaxEditDistance);
+    }
+    Diagnostics::recordDuration("Line changes against HEAD", timer.nsecsElapsed() / 1000);
+
+    QMetaObject::invokeMethod(this, [this, job, hunks]() {
+        if (job != diffJob) {
+            return;
+        }
+        diffJob.reset();
+        emit changesReady(job->filePath, hunks);
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,71 @@
+#ifndef LINECHANGETRACKER_H
+#define LINECHANGETRACKER_H
+
+#include <QObject>
+#include <QCache>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+
+#include "linediff.h"
+#include "gitjobqueue.h"
+
+// Compares the text being edited with the committed version of its file.
+// The committed text is read once per file with `git show` and kept until
+// HEAD moves; the diff itself runs on a worker thread, a newer request
+// cancelling the one before.
+class LineChangeTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Larger files are not compared at all
+    static const int MaxDiffLines = 20000;
+
+    explicit LineChangeTracker(QObject *parent = nullptr);
+    ~LineChangeTracker();
+
+    // The top of the working tree; empty turns tracking off
+    void setRepository(const QString &root);
+    void setHeadCommit(const QString &commit);
+
+    // The result arrives as changesReady, empty for files git does not track
+    void update(const QString &filePath, const QString &text);
+
+signals:
+    void changesReady(const QString &filePath, const QVector<LineDiff::Hunk> &hunks);
+
+private slots:
+    void onBaseFetched(const GitJobQueue::Result &result);
+
+private:
+    struct Base
+    {
+        bool tracked = false;
+        QStringList lines;
+    };
+
+    struct DiffJob;
+
+    void startDiff();
+    void diff(std::shared_ptr<DiffJob> job);
+    void clearBases();
+
+    QString repositoryRoot;
+    QString headCommit;
+    GitJobQueue *jobQueue;
+    QCache<QString, Base> bases;    // committed text by file path
+    QHash<int, QString> fetching;   // file path by `git show` job id
+
+    // The latest request; only that one is diffed
+    QString pendingPath;
+    QString pendingText;
+
+    std::shared_ptr<DiffJob> diffJob;
+    QThreadPool pool;
+};
+
+#endif // LINECHANGETRACKER_H
@@ -0,0 +1,122 @@
+#include "linediff.h"
+
+QVector<LineDiff::Hunk> LineDiff::diff(const QStringList &oldLines, const QStringList &newLines,
+                                       int maxEditDistance)
+{
+    const int oldSize = oldLines.size();
+    const int newSize = newLines.size();
+
+    // Most edits touch a small region; strip the common ends before diffing
+    int prefix = 0;
+    while (prefix < oldSize && prefix < newSize && oldLines[prefix] == newLines[prefix]) {
+        ++prefix;
+    }
+    int suffix = 0;
+    while (suffix < oldSize - prefix && suffix < newSize - prefix
+           && oldLines[oldSize - 1 - suffix] == newLines[newSize - 1 - suffix]) {
+        ++suffix;
+    }
+
+    const int oldCount = oldSize - prefix - suffix;
+    const int newCount = newSize - prefix - suffix;
+
+    QVector<Hunk> hunks;
+    if (oldCount == 0 && newCount == 0) {
+        return hunks;
+    }
+    if (oldCount == 0 || newCount == 0) {
+        hunks.append({prefix, oldCount, prefix, newCount});
+        return hunks;
+    }
+
+    auto oldLine = [&](int index) -> const QString & { return oldLines[prefix + index]; };
+    auto newLine = [&](int index) -> const QString & { return newLines[prefix + index]; };
+
+    // Forward pass, keeping the furthest x per diagonal for every edit distance
+    const int bound = qMin(oldCount + newCount, maxEditDistance);
+    const int offset = bound + 1;
+    QVector<int> v(2 * bound + 3, 0);
+    QVector<QVector<int>> trace;
+    bool found = false;
+
+    for (int d = 0; d <= bound && !found; ++d) {
+        trace.append(v);
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) {
+                x = v[offset + k + 1];
+            } else {
+                x = v[offset + k - 1] + 1;
+            }
+            int y = x - k;
+            while (x < oldCount && y < newCount && oldLine(x) == newLine(y)) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= oldCount && y >= newCount) {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    if (!found) {
+        hunks.append({prefix, oldCount, prefix, newCount});
+        return hunks;
+    }
+
+    // Walk back through the trace, marking the lines that are not shared
+    QVector<bool> deleted(oldCount, false);
+    QVector<bool> inserted(newCount, false);
+    int x = oldCount;
+    int y = newCount;
+    for (int d = trace.size() - 1; d >= 0; --d) {
+        const QVector<int> &previous = trace[d];
+        int k = x - y;
+        int previousK;
+        if (k == -d || (k != d && previous[offset + k - 1] < previous[offset + k + 1])) {
+            previousK = k + 1;
+        } else {
+            previousK = k - 1;
+        }
+        int previousX = previous[offset + previousK];
+        int previousY = previousX - previousK;
+
+        while (x > previousX && y > previousY) {
+            --x;
+            --y;
+        }
+        if (d > 0) {
+            if (x == previousX) {
+                inserted[previousY] = true;
+            } else {
+                deleted[previousX] = true;
+            }
+        }
+        x = previousX;
+        y = previousY;
+    }
+
+    // Unmarked lines pair up in order; each run of marked lines becomes a hunk
+    int i = 0;
+    int j = 0;
+    while (i < oldCount || j < newCount) {
+        if (i < oldCount && j < newCount && !deleted[i] && !inserted[j]) {
+            ++i;
+            ++j;
+            continue;
+        }
+        int oldStart = i;
+        int newStart = j;
+        while (i < oldCount && deleted[i]) {
+            ++i;
+        }
+        while (j < newCount && inserted[j]) {
+            ++j;
+        }
+        hunks.append({prefix + oldStart, i - oldStart, prefix + newStart, j - newStart});
+    }
+
+    return hunks;
+}
@@ -0,0 +1,26 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QStringList>
+#include <QVector>
+
+class LineDiff
+{
+public:
+    // Lines [oldStart, oldStart + oldCount) of the old text are replaced by
+    // lines [newStart, newStart + newCount) of the new text
+    struct Hunk
+    {
+        int oldStart;
+        int oldCount;
+        int newStart;
+        int newCount;
+    };
+
+    // Myers diff over lines. When the texts differ by more than maxEditDistance
+    // lines, the differing middle section is returned as a single hunk.
+    static QVector<Hunk> diff(const QStringList &oldLines, const QStringList &newLines,
+                              int maxEditDistance = 1000);
+};
+
+#endif // LINEDIFF_H
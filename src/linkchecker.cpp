@@ -0,0 +1,166 @@
+#include "linkchecker.h"
+#include "markdownlinks.h"
+#include "workspaceindexer.h"
+#include "filedecoder.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+namespace {
+
+// Files outside the index that are larger than this are not read for anchors
+const qint64 MaxAnchorFileSize = 4 * 1024 * 1024;
+
+// Anchors kept for files outside the index, in kilobytes
+const int MaxAnchorCacheCost = 1024;
+
+bool isMarkdownFile(const QString &filePath)
+{
+    return filePath.endsWith(".md", Qt::CaseInsensitive)
+        || filePath.endsWith(".markdown", Qt::CaseInsensitive);
+}
+
+} // namespace
+
+LinkChecker::LinkChecker(const WorkspaceIndexer *indexer, QObject *parent)
+    : QObject(parent)
+    , indexer(indexer)
+{
+    anchorCache.setMaxCost(MaxAnchorCacheCost);
+    readPool.setMaxThreadCount(1);
+}
+
+LinkChecker::~LinkChecker()
+{
+    // Results posted by running reads are discarded together with this object
+    readPool.clear();
+    readPool.waitForDone();
+}
+
+QVector<LinkChecker::Problem> LinkChecker::check(const QString &filePath, const QString &text)
+{
+    QVector<Problem> problems;
+    QVector<MarkdownLinks::Link> links = MarkdownLinks::extractLinks(text);
+    if (links.isEmpty()) {
+        return problems;
+    }
+
+    // A document tends to link to the same few files, so each is looked at once per pass
+    QHash<QString, bool> exists;
+    QHash<QString, QStringList> targetAnchors;
+    QStringList ownAnchors;
+    bool ownAnchorsRead = false;
+
+    for (const MarkdownLinks::Link &link : links) {
+        QString target;
+        QString fragment;
+        if (!MarkdownLinks::resolveTarget(filePath, link.target, &target, &fragment)) {
+            continue;
+        }
+
+        Problem problem;
+        problem.position = link.position;
+        problem.length = link.length;
+
+        if (!target.isEmpty()) {
+            auto known = exists.find(target);
+            if (known == exists.end()) {
+                known = exists.insert(target, QFileInfo::exists(target));
+            }
+            if (!known.value()) {
+                problem.message = link.image ? QString("Image not found: %1").arg(target)
+                                             : QString("File not found: %1").arg(target);
+                problems.append(problem);
+                continue;
+            }
+        }
+
+        if (fragment.isEmpty() || (!target.isEmpty() && !isMarkdownFile(target))) {
+            continue;
+        }
+
+        const QStringList *anchors = nullptr;
+        if (target.isEmpty()) {
+            if (!ownAnchorsRead) {
+                ownAnchors = MarkdownLinks::headingAnchors(text);
+                ownAnchorsRead = true;
+            }
+            anchors = &ownAnchors;
+        } else {
+            auto cached = targetAnchors.find(target);
+            if (cached == targetAnchors.end()) {
+                QStringList list;
+                if (!anchorsOf(target, &list)) {
+                    continue;
+                }
+                cached = targetAnchors.insert(target, list);
+            }
+            anchors = &cached.value();
+        }
+
+        if (!anchors->contains(fragment.toLower())) {
+            QString where = target.isEmpty() ? QString("this document") : QFileInfo(target).fileName();
+            problem.message = QString("No heading \"#%1\" in %2").arg(fragment, where);
+            problems.append(problem);
+        }
+    }
+    return problems;
+}
+
+bool LinkChecker::anchorsOf(const QString &filePath, QStringList *anchors)
+{
+    if (indexer && indexer->anchors(filePath, anchors)) {
+        return true;
+    }
+
+    QFileInfo fileInfo(filePath);
+    qint64 modified = fileInfo.lastModified().toMSecsSinceEpoch();
+    qint64 size = fileInfo.size();
+    if (size > MaxAnchorFileSize) {
+        return false;
+    }
+    CachedAnchors *cached = anchorCache.object(filePath);
+    if (cached && cached->modified == modified && cached->size == size) {
+        *anchors = cached->anchors;
+        return cached->readable;
+    }
+
+    // Decoding happens off the GUI thread; until then the fragment goes unchecked
+    if (!pendingReads.contains(filePath)) {
+        pendingReads.insert(filePath);
+        readPool.start([this, filePath, modified, size]() {
+            QString text;
+            QStringList anchors;
+            bool readable = FileDecoder::readFile(filePath, &text, nullptr, FileDecoder::Copy);
+            if (readable) {
+                anchors = MarkdownLinks::headingAnchors(text);
+            }
+            QMetaObject::invokeMethod(this, [this, filePath, modified, size, readable, anchors]() {
+                onAnchorsRead(filePath, modified, size, readable, anchors);
+            }, Qt::QueuedConnection);
+        });
+    }
+    return false;
+}
+
+void LinkChecker::onAnchorsRead(const QString &filePath, qint64 modified, qint64 size, bool readable,
+                                const QStringList &anchors)
+{
+    pendingReads.remove(filePath);
+
+    // Unreadable files are remembered too, so they are not read again until they change
+    CachedAnchors *entry = new CachedAnchors;
+    entry->modified = modified;
+    entry->size = size;
+    entry->readable = readable;
+    entry->anchors = anchors;
+    qint64 bytes = 0;
+    for (const QString &anchor : anchors) {
+        bytes += anchor.size() * qint64(sizeof(QChar));
+    }
+    anchorCache.insert(filePath, entry, qMax(1, int(bytes / 1024)));
+
+    if (readable) {
+        emit anchorsReady();
+    }
+}
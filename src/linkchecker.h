@@ -0,0 +1,60 @@
+#ifndef LINKCHECKER_H
+#define LINKCHECKER_H
+
+#include <QObject>
+#include <QCache>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+class WorkspaceIndexer;
+
+// Finds links in a markdown document that point at missing files or at
+// headings the target does not have. Anchors of other files come from the
+// workspace index when it has them; files outside it are read on a
+// background thread and cached until their mtime or size changes, and their
+// fragments are checked once anchorsReady reports them.
+class LinkChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Problem
+    {
+        int position = 0;  // of the link target
+        int length = 0;
+        QString message;
+    };
+
+    explicit LinkChecker(const WorkspaceIndexer *indexer, QObject *parent = nullptr);
+    ~LinkChecker();
+
+    QVector<Problem> check(const QString &filePath, const QString &text);
+
+signals:
+    // Anchors of a file outside the index were read; checking again sees them
+    void anchorsReady();
+
+private:
+    struct CachedAnchors
+    {
+        qint64 modified = 0;
+        qint64 size = 0;
+        bool readable = false;
+        QStringList anchors;
+    };
+
+    // False while the file is still being read, or cannot be
+    bool anchorsOf(const QString &filePath, QStringList *anchors);
+    void onAnchorsRead(const QString &filePath, qint64 modified, qint64 size, bool readable,
+                       const QStringList &anchors);
+
+    const WorkspaceIndexer *indexer;
+    QCache<QString, CachedAnchors> anchorCache;  // cost in kilobytes
+    QSet<QString> pendingReads;
+    QThreadPool readPool;
+};
+
+#endif // LINKCHECKER_H
@@ -3,27 +3,85 @@
 #include "previewwidget.h"
 #include "filebrowser.h"
 #include "gitwidget.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "editjournal.h"
+#include "filedecoder.h"
+#include "largefileviewer.h"
+#include "diagnostics.h"
+#include "markdownconverter.h"
+#include "workspaceindexer.h"
+#include "searchpanel.h"
+#include "pathindex.h"
+#include "quickopendialog.h"
+#include "backlinkspanel.h"
+#include "linkchecker.h"
+#include "outlinepanel.h"
+#include "linechangetracker.h"
+#include "gitblame.h"
 
 #include <QMenuBar>
 #include <QToolBar>
 #include <QFileDialog>
 #include <QFile>
-#include <QTextStream>
 #include <QMessageBox>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QApplication>
 #include <QCloseEvent>
+#include <QSettings>
+#include <QStatusBar>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QPlainTextEdit>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTabBar>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QScrollBar>
+#include <QSignalBlocker>
+#include <algorithm>
+
+namespace {
+
+// Larger files are read on a worker thread and inserted into the editor in chunks
+const qint64 ChunkedLoadThreshold = 4 * 1024 * 1024;
+
+// Link checks rescan the whole text, so very long documents are skipped
+const int MaxLinkCheckLength = 2 * 1024 * 1024;
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , currentFilePath("")
     , splitEditorEnabled(false)
     , isModified(false)
+    , loadingFile(false)
+    , viewerMode(false)
+    , editRevision(0)
+    , previewGeneration(0)
+    , previewDocumentId(0)
+    , previewRevision(0)
+    , activeDocument(-1)
+    , nextDocumentId(0)
+    , useCounter(0)
 {
     setWindowTitle("Markdown Editor");
     resize(1400, 800);
 
+    QSettings settings;
+    renderCache.setMemoryBudget(settings.value("renderCache/memoryBudgetMB", 64).toLongLong() * 1024 * 1024);
+    renderCache.setDiskCacheEnabled(settings.value("renderCache/diskCache", false).toBool());
+    viewerThreshold = settings.value("largeFiles/viewerThresholdMB", 64).toLongLong() * 1024 * 1024;
+    documentMemoryBudget = settings.value("documents/memoryBudgetMB", 256).toLongLong() * 1024 * 1024;
+    prerenderPool.setMaxThreadCount(1);
+
     // Create actions first
     createActions();
 
@@ -38,22 +96,82 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Create file browser
     fileBrowser = new FileBrowser(this);
+    // Ignored folders such as node_modules are left out, and never read
+    fileBrowser->setHideIgnored(settings.value("fileBrowser/hideIgnored", true).toBool());
+    QStringList ignorePatterns = settings.value("fileBrowser/ignorePatterns",
+                                                QStringList() << "node_modules/").toStringList();
+    fileBrowser->setIgnorePatterns(ignorePatterns);
+    fileBrowser->setMaxWatchedDirectories(settings.value("fileBrowser/maxWatchedDirectories", 1000).toInt());
+    fileBrowser->setShowThumbnails(settings.value("fileBrowser/thumbnails", true).toBool());
+    hideIgnoredAction->setChecked(fileBrowser->hidesIgnored());
     connect(fileBrowser, &FileBrowser::fileSelected, this, &MainWindow::onFileSelected);
 
+    // Full-text search over the folder shown in the file browser
+    workspaceIndexer = new WorkspaceIndexer(this);
+    workspaceIndexer->setIgnorePatterns(ignorePatterns);
+    searchPanel = new SearchPanel(workspaceIndexer, this);
+    searchPanel->setVisible(false);  // Hidden by default
+    connect(searchPanel, &SearchPanel::fileSelected, this, &MainWindow::onFileSelected);
+
+    // Files linking to the current one, from the same index
+    backlinksPanel = new BacklinksPanel(workspaceIndexer, this);
+    backlinksPanel->setVisible(false);  // Hidden by default
+    connect(backlinksPanel, &BacklinksPanel::fileSelected, this, &MainWindow::onFileSelected);
+
+    // Headings of the current document, for jumping between sections
+    outlinePanel = new OutlinePanel(this);
+    outlinePanel->setVisible(false);  // Hidden by default
+    connect(outlinePanel, &OutlinePanel::headingActivated, this, &MainWindow::jumpToHeading);
+
+    // Ctrl+P finder over every path under the file browser's root
+    pathIndex = new PathIndex(FileBrowser::nameFilters(), this);
+    pathIndex->setIgnorePatterns(ignorePatterns);
+    quickOpenDialog = new QuickOpenDialog(pathIndex, this);
+    connect(quickOpenDialog, &QuickOpenDialog::fileSelected, this, &MainWindow::onFileSelected);
+
+    sidebarSplitter = new QSplitter(Qt::Vertical, this);
+    sidebarSplitter->addWidget(fileBrowser);
+    sidebarSplitter->addWidget(searchPanel);
+    sidebarSplitter->addWidget(backlinksPanel);
+    sidebarSplitter->addWidget(outlinePanel);
+
     // Create editor/preview splitter
     editorSplitter = new QSplitter(Qt::Horizontal, this);
 
+    // One tab per open document
+    tabBar = new QTabBar(this);
+    tabBar->setTabsClosable(true);
+    tabBar->setMovable(true);
+    tabBar->setDocumentMode(true);
+    tabBar->setExpanding(false);
+    connect(tabBar, &QTabBar::currentChanged, this, &MainWindow::onTabChanged);
+    connect(tabBar, &QTabBar::tabMoved, this, &MainWindow::onTabMoved);
+    connect(tabBar, &QTabBar::tabCloseRequested, this, &MainWindow::closeTab);
+    connect(tabBar, &QTabBar::tabBarClicked, this, [this](int index) {
+        // The large file viewer covers the current tab; clicking it goes back
+        if (viewerMode && index >= 0) {
+            activateDocument(index);
+        }
+    });
+
     // Create editor view splitter (for split editor mode)
     editorViewSplitter = new QSplitter(Qt::Horizontal, this);
 
     // Create editors
     editor = new MarkdownEditor(this);
     connect(editor, &MarkdownEditor::textChanged, [this]() {
-        preview->updatePreview(editor->toPlainText());
-        if (splitEditorEnabled && editor2) {
+        // First, so the render below is filed under this edit
+        documentModified();
+        // loadFile renders the preview itself, possibly from the render cache
+        if (!loadingFile) {
+            renderPreview(editor->toPlainText());
+        }
+        // Chunked loads copy the finished text across once instead of per chunk
+        if (splitEditorEnabled && editor2 && !fileLoader->isRunning()) {
             syncEditors();
         }
-        documentModified();
+        linkCheckTimer->start();
+        lineChangeTimer->start();
     });
 
     editor2 = new MarkdownEditor(this);
@@ -66,10 +184,21 @@ MainWindow::MainWindow(QWidget *parent)
 
     // Create preview
     preview = new PreviewWidget(this);
+    QString themeFile = settings.value("preview/themeFile").toString();
+    if (!themeFile.isEmpty()) {
+        preview->setThemeFile(themeFile);
+    }
+    connect(preview, &PreviewWidget::previewRendered, this, &MainWindow::onPreviewRendered);
 
     // Create git widget
     gitWidget = new GitWidget(this);
     gitWidget->setVisible(false);  // Hidden by default
+    gitWidget->setReadIndexDirectly(settings.value("git/readIndexDirectly", false).toBool());
+
+    // Read-only viewer for files too large for the editor; the preview shows the visible part
+    largeFileViewer = new LargeFileViewer(this);
+    largeFileViewer->setVisible(false);
+    connect(largeFileViewer, &LargeFileViewer::windowChanged, preview, &PreviewWidget::updatePreview);
 
     // Connect scroll synchronization
     connect(editor, &MarkdownEditor::scrollPercentageChanged, 
@@ -78,8 +207,15 @@ MainWindow::MainWindow(QWidget *parent)
     // Setup initial layout (single editor + preview)
     updateEditorLayout();
 
-    mainSplitter->addWidget(fileBrowser);
-    mainSplitter->addWidget(editorSplitter);
+    QWidget *documentArea = new QWidget(this);
+    QVBoxLayout *documentLayout = new QVBoxLayout(documentArea);
+    documentLayout->setContentsMargins(0, 0, 0, 0);
+    documentLayout->setSpacing(0);
+    documentLayout->addWidget(tabBar);
+    documentLayout->addWidget(editorSplitter);
+
+    mainSplitter->addWidget(sidebarSplitter);
+    mainSplitter->addWidget(documentArea);
     mainSplitter->addWidget(gitWidget);
     mainSplitter->setStretchFactor(0, 0);
     mainSplitter->setStretchFactor(1, 1);
@@ -90,6 +226,35 @@ MainWindow::MainWindow(QWidget *parent)
 
     setCentralWidget(mainSplitter);
 
+    // Chunked loading of large files, with progress and cancellation in the status bar
+    fileLoader = new FileLoader(this);
+    connect(fileLoader, &FileLoader::chunkReady, this, &MainWindow::onLoadChunk);
+    connect(fileLoader, &FileLoader::finished, this, &MainWindow::onLoadFinished);
+    connect(fileLoader, &FileLoader::failed, this, &MainWindow::onLoadFailed);
+
+    loadProgressBar = new QProgressBar(this);
+    loadProgressBar->setRange(0, 100);
+    loadProgressBar->setMaximumWidth(200);
+    loadProgressBar->setVisible(false);
+    connect(fileLoader, &FileLoader::progressChanged, loadProgressBar, &QProgressBar::setValue);
+    statusBar()->addPermanentWidget(loadProgressBar);
+
+    cancelLoadButton = new QPushButton(tr("Cancel"), this);
+    cancelLoadButton->setVisible(false);
+    connect(cancelLoadButton, &QPushButton::clicked, this, &MainWindow::cancelLoad);
+    statusBar()->addPermanentWidget(cancelLoadButton);
+
+    // Saves are written on a worker thread; the editor stays usable meanwhile
+    fileSaver = new FileSaver(this);
+    connect(fileSaver, &FileSaver::saved, this, &MainWindow::onFileSaved);
+    connect(fileSaver, &FileSaver::failed, this, &MainWindow::onFileSaveFailed);
+
+    connect(largeFileViewer, &LargeFileViewer::indexingProgress, loadProgressBar, &QProgressBar::setValue);
+    connect(largeFileViewer, &LargeFileViewer::indexingFinished, this, [this](int lineCount) {
+        loadProgressBar->setVisible(false);
+        statusBar()->showMessage(tr("Read-only view, %1 lines").arg(lineCount), 5000);
+    });
+
     // Connect editor actions
     connect(undoAction, &QAction::triggered, editor, &MarkdownEditor::undo);
     connect(redoAction, &QAction::triggered, editor, &MarkdownEditor::redo);
@@ -105,10 +270,81 @@ MainWindow::MainWindow(QWidget *parent)
         cutAction->setEnabled(available);
         copyAction->setEnabled(available);
     });
+
+    // Changes made to the open file by other programs are merged into the buffer
+    fileWatcher = new QFileSystemWatcher(this);
+    connect(fileWatcher, &QFileSystemWatcher::fileChanged, this, &MainWindow::onFileChangedOnDisk);
+    externalChangeTimer = new QTimer(this);
+    externalChangeTimer->setSingleShot(true);
+    externalChangeTimer->setInterval(200);
+    connect(externalChangeTimer, &QTimer::timeout, this, &MainWindow::reloadChangedFile);
+
+    // Broken links are underlined in the editor; the index supplies other files' headings
+    linkChecker = new LinkChecker(workspaceIndexer, this);
+    linkCheckTimer = new QTimer(this);
+    linkCheckTimer->setSingleShot(true);
+    linkCheckTimer->setInterval(500);
+    connect(linkCheckTimer, &QTimer::timeout, this, &MainWindow::checkLinks);
+    connect(linkChecker, &LinkChecker::anchorsReady, linkCheckTimer, [this]() {
+        linkCheckTimer->start();
+    });
+    connect(workspaceIndexer, &WorkspaceIndexer::indexingFinished, linkCheckTimer, [this]() {
+        linkCheckTimer->start();
+    });
+
+    // Lines changed since the last commit are marked beside the text, for
+    // as long as the git panel has found a repository
+    lineChangeTracker = new LineChangeTracker(this);
+    lineChangeTimer = new QTimer(this);
+    lineChangeTimer->setSingleShot(true);
+    lineChangeTimer->setInterval(300);
+    connect(lineChangeTimer, &QTimer::timeout, this, &MainWindow::updateLineChanges);
+    connect(lineChangeTracker, &LineChangeTracker::changesReady, this,
+            [this](const QString &filePath, const QVector<LineDiff::Hunk> &hunks) {
+        if (filePath == currentFilePath) {
+            editor->setLineChanges(hunks);
+        }
+    });
+
+    // Blame of the committed file, lined up with the text through the changes above
+    gitBlame = new GitBlame(this);
+    connect(gitBlame, &GitBlame::blameUpdated, this, [this](const QString &filePath) {
+        if (filePath == currentFilePath && blameAction->isChecked()) {
+            editor->setBlame(gitBlame->lines(filePath));
+        }
+    });
+
+    connect(gitWidget, &GitWidget::repositoryChanged, this, [this](const QString &root) {
+        lineChangeTracker->setRepository(root);
+        gitBlame->setRepository(root);
+        editor->setLineChangesShown(!root.isEmpty());
+        lineChangeTimer->start();
+        updateBlame();
+    });
+    connect(gitWidget, &GitWidget::headChanged, this, [this](const QString &commit) {
+        lineChangeTracker->setHeadCommit(commit);
+        gitBlame->setHeadCommit(commit);
+        lineChangeTimer->start();
+        updateBlame();
+    });
+
+    activateDocument(addDocument(QString()));
+
+    // Offer to restore edits left behind by a session that did not exit cleanly
+    QTimer::singleShot(0, this, &MainWindow::recoverUnsavedChanges);
 }
 
 MainWindow::~MainWindow()
 {
+    // Background renders post their results back to this window
+    prerenderPool.clear();
+    prerenderPool.waitForDone();
+
+    // Write out pending journal records while the documents still exist
+    for (Document *document : documents) {
+        document->journal->setDocument(nullptr);
+    }
+    qDeleteAll(documents);
 }
 
 void MainWindow::createActions()
@@ -124,6 +360,10 @@ void MainWindow::createActions()
     openFolderAction = new QAction(tr("Open &Folder"), this);
     connect(openFolderAction, &QAction::triggered, this, &MainWindow::openFolder);
 
+    quickOpenAction = new QAction(tr("&Quick Open..."), this);
+    quickOpenAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_P));
+    connect(quickOpenAction, &QAction::triggered, this, &MainWindow::showQuickOpen);
+
     saveAction = new QAction(tr("&Save"), this);
     saveAction->setShortcut(QKeySequence::Save);
     connect(saveAction, &QAction::triggered, this, &MainWindow::saveFile);
@@ -132,6 +372,10 @@ void MainWindow::createActions()
     saveAsAction->setShortcut(QKeySequence::SaveAs);
     connect(saveAsAction, &QAction::triggered, this, &MainWindow::saveFileAs);
 
+    closeTabAction = new QAction(tr("&Close Tab"), this);
+    closeTabAction->setShortcut(QKeySequence::Close);
+    connect(closeTabAction, &QAction::triggered, this, &MainWindow::closeCurrentTab);
+
     undoAction = new QAction(tr("&Undo"), this);
     undoAction->setShortcut(QKeySequence::Undo);
     undoAction->setEnabled(false);
@@ -172,6 +416,33 @@ void MainWindow::createActions()
     gitPanelAction->setCheckable(true);
     connect(gitPanelAction, &QAction::triggered, this, &MainWindow::toggleGitPanel);
 
+    searchAction = new QAction(tr("Search in &Files"), this);
+    searchAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F));
+    searchAction->setCheckable(true);
+    connect(searchAction, &QAction::triggered, this, &MainWindow::toggleSearchPanel);
+
+    backlinksAction = new QAction(tr("&Backlinks"), this);
+    backlinksAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_B));
+    backlinksAction->setCheckable(true);
+    connect(backlinksAction, &QAction::triggered, this, &MainWindow::toggleBacklinksPanel);
+
+    outlineAction = new QAction(tr("&Outline"), this);
+    outlineAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_O));
+    outlineAction->setCheckable(true);
+    connect(outlineAction, &QAction::triggered, this, &MainWindow::toggleOutlinePanel);
+
+    blameAction = new QAction(tr("B&lame"), this);
+    blameAction->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_L));
+    blameAction->setCheckable(true);
+    connect(blameAction, &QAction::triggered, this, &MainWindow::updateBlame);
+
+    hideIgnoredAction = new QAction(tr("&Hide Ignored Files"), this);
+    hideIgnoredAction->setCheckable(true);
+    connect(hideIgnoredAction, &QAction::triggered, this, &MainWindow::toggleHideIgnored);
+
+    diagnosticsAction = new QAction(tr("&Diagnostics..."), this);
+    connect(diagnosticsAction, &QAction::triggered, this, &MainWindow::showDiagnostics);
+
     quitAction = new QAction(tr("&Quit"), this);
     quitAction->setShortcut(QKeySequence::Quit);
     connect(quitAction, &QAction::triggered, this, &MainWindow::quitApplication);
@@ -186,9 +457,11 @@ void MainWindow::createMenuBar()
     fileMenu->addAction(newAction);
     fileMenu->addAction(openAction);
     fileMenu->addAction(openFolderAction);
+    fileMenu->addAction(quickOpenAction);
     fileMenu->addSeparator();
     fileMenu->addAction(saveAction);
     fileMenu->addAction(saveAsAction);
+    fileMenu->addAction(closeTabAction);
     fileMenu->addSeparator();
     fileMenu->addAction(quitAction);
 
@@ -207,6 +480,15 @@ void MainWindow::createMenuBar()
     QMenu *viewMenu = menuBar->addMenu(tr("&View"));
     viewMenu->addAction(splitEditorAction);
     viewMenu->addAction(gitPanelAction);
+    viewMenu->addAction(searchAction);
+    viewMenu->addAction(backlinksAction);
+    viewMenu->addAction(outlineAction);
+    viewMenu->addAction(blameAction);
+    viewMenu->addAction(hideIgnoredAction);
+    viewMenu->addSeparator();
+    themeMenu = viewMenu->addMenu(tr("Preview &Theme"));
+    connect(themeMenu, &QMenu::aboutToShow, this, &MainWindow::populateThemeMenu);
+    viewMenu->addAction(diagnosticsAction);
     viewMenu->addSeparator();
     viewMenu->addAction(fullScreenAction);
     viewMenu->addAction(exitFullScreenAction);
@@ -236,24 +518,15 @@ void MainWindow::createToolBar()
 
 void MainWindow::newFile()
 {
-    // Clear the editor
-    editor->clear();
-    
-    // Clear the preview
-    preview->updatePreview("");
-    
-    // Reset current file path
-    currentFilePath.clear();
-    editor->setCurrentFilePath("");
-    if (editor2) {
-        editor2->setCurrentFilePath("");
+    if (fileLoader->isRunning()) {
+        cancelLoad();
     }
-    
-    // Reset modified flag
-    isModified = false;
-    
-    // Update window title
-    updateWindowTitle();
+    if (viewerMode) {
+        closeViewer();
+    }
+
+    // Opens in a new tab, unless the current one is still empty
+    useBlankDocument();
     
     // Make sure editor and preview are visible
     editor->setVisible(true);
@@ -288,6 +561,7 @@ void MainWindow::openFolder()
 
     if (!dirPath.isEmpty()) {
         fileBrowser->setRootPath(dirPath);
+        workspaceIndexer->setRootPath(dirPath);
         
         // Update git widget with the folder path
         if (gitWidget->isVisible()) {
@@ -296,6 +570,13 @@ void MainWindow::openFolder()
     }
 }
 
+void MainWindow::showQuickOpen()
+{
+    // Listed again each time so new files show up; the old list serves meanwhile
+    pathIndex->setRootPath(fileBrowser->getRootPath());
+    quickOpenDialog->popup();
+}
+
 void MainWindow::saveFile()
 {
     if (currentFilePath.isEmpty()) {
@@ -315,10 +596,11 @@ void MainWindow::saveFileAs()
     );
 
     if (!filePath.isEmpty()) {
-        if (saveFileToPath(filePath)) {
-            currentFilePath = filePath;
-            // saveFileToPath already resets isModified and updates title
+        // The document keeps its old path until the write has succeeded
+        if (activeDocument >= 0) {
+            saveAsTargets.insert(filePath, documents[activeDocument]->id);
         }
+        saveFileToPath(filePath);
     }
 }
 
@@ -338,22 +620,238 @@ void MainWindow::onFileSelected(const QString &filePath)
 
 void MainWindow::loadFile(const QString &filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (fileLoader->isRunning()) {
+        cancelLoad();
+    }
+
+    // A file that is already open is switched to rather than read again
+    int existing = findDocument(filePath);
+    if (existing >= 0) {
+        activateDocument(existing);
+        return;
+    }
+
+    QFileInfo fileInfo(filePath);
+    if (fileInfo.size() > viewerThreshold) {
+        openInViewer(filePath);
+        return;
+    }
+    if (viewerMode) {
+        closeViewer();
+    }
+
+    if (fileInfo.size() > ChunkedLoadThreshold) {
+        useBlankDocument();
+        startChunkedLoad(filePath);
+        return;
+    }
+
+    RenderCache::Entry entry;
+
+    // Files seen recently with an unchanged mtime skip reading and rendering entirely
+    if (!renderCache.find(filePath, fileInfo.lastModified(), fileInfo.size(), &entry)) {
+        QString error;
+        if (!FileDecoder::readFile(filePath, &entry.content, &error)) {
+            QMessageBox::warning(this, tr("Error"), tr("Cannot read file %1:\n%2")
+                .arg(filePath)
+                .arg(error));
+            return;
+        }
+
+        entry.modified = fileInfo.lastModified();
+        entry.size = fileInfo.size();
+        entry.hash = RenderCache::contentHash(entry.content);
+        entry.html = renderCache.findHtmlOnDisk(filePath, entry.hash);
+    }
+
+    useBlankDocument();
+
+    // Resolve relative image paths before the preview renders the new content
+    preview->setCurrentFilePath(filePath);
+
+    loadingFile = true;
+    editor->setPlainText(entry.content);
+    loadingFile = false;
+
+    if (entry.html.isEmpty()) {
+        // Cached once the preview reports the html for this content
+        pendingCachePath = filePath;
+        pendingCacheEntry = entry;
+        renderPreview(entry.content);
+    } else {
+        pendingCachePath.clear();
+        preview->showHtml(entry.html);
+        renderCache.insert(filePath, entry);
+
+        Document *document = documents[activeDocument];
+        document->html = entry.html;
+        document->htmlRevision = editRevision;
+        document->hasHtml = true;
+    }
+
+    finishLoad(filePath);
+}
+
+void MainWindow::openInViewer(const QString &filePath)
+{
+    QString error;
+    if (!largeFileViewer->open(filePath, &error)) {
+        if (viewerMode) {
+            closeViewer();
+        }
         QMessageBox::warning(this, tr("Error"), tr("Cannot read file %1:\n%2")
             .arg(filePath)
-            .arg(file.errorString()));
+            .arg(error));
         return;
     }
 
-    QTextStream in(&file);
-    QString content = in.readAll();
-    editor->setPlainText(content);
-    file.close();
+    pendingCachePath.clear();
+    preview->setCurrentFilePath(filePath);
 
-    // Explicitly update the preview
-    preview->updatePreview(content);
-    
+    // The open tabs stay as they are; the viewer covers the current one
+    storeActiveDocument();
+    editor->setReadOnly(true);
+    setViewerMode(true);
+
+    if (largeFileViewer->isIndexing()) {
+        loadProgressBar->setValue(0);
+        loadProgressBar->setVisible(true);
+        statusBar()->showMessage(tr("Indexing %1...").arg(QFileInfo(filePath).fileName()));
+    }
+
+    currentFilePath = filePath;
+    editor->setCurrentFilePath(filePath);
+    editor2->setCurrentFilePath(filePath);
+    isModified = false;
+    updateWindowTitle();
+    watchOpenFiles();
+}
+
+void MainWindow::closeViewer()
+{
+    largeFileViewer->close();
+    editor->setReadOnly(false);
+    loadProgressBar->setVisible(false);
+    statusBar()->clearMessage();
+    setViewerMode(false);
+
+    if (activeDocument >= 0) {
+        showActiveDocument();
+    }
+}
+
+void MainWindow::setViewerMode(bool enabled)
+{
+    viewerMode = enabled;
+
+    // The viewer never holds the whole file, so there is nothing to save
+    saveAction->setEnabled(!enabled);
+    saveAsAction->setEnabled(!enabled);
+    splitEditorAction->setEnabled(!enabled);
+
+    updateEditorLayout();
+}
+
+void MainWindow::startChunkedLoad(const QString &filePath)
+{
+    preview->setCurrentFilePath(filePath);
+    pendingCachePath.clear();
+    chunkedLoadPath = filePath;
+
+    // Keep the partially loaded buffer read-only and out of the undo history
+    loadingFile = true;
+    editor->setReadOnly(true);
+    editor->document()->setUndoRedoEnabled(false);
+    editor->clear();
+    tabBar->setEnabled(false);
+
+    loadProgressBar->setValue(0);
+    loadProgressBar->setVisible(true);
+    cancelLoadButton->setVisible(true);
+    statusBar()->showMessage(tr("Loading %1...").arg(QFileInfo(filePath).fileName()));
+
+    fileLoader->start(filePath);
+}
+
+void MainWindow::endChunkedLoad()
+{
+    editor->document()->setUndoRedoEnabled(true);
+    editor->setReadOnly(false);
+    loadingFile = false;
+    tabBar->setEnabled(true);
+
+    loadProgressBar->setVisible(false);
+    cancelLoadButton->setVisible(false);
+    statusBar()->clearMessage();
+}
+
+void MainWindow::onLoadChunk(const QString &text)
+{
+    editor->appendText(text);
+}
+
+void MainWindow::onLoadFinished()
+{
+    QString filePath = chunkedLoadPath;
+    endChunkedLoad();
+
+    QFileInfo fileInfo(filePath);
+    QString content = editor->toPlainText();
+
+    pendingCachePath = filePath;
+    pendingCacheEntry = RenderCache::Entry();
+    pendingCacheEntry.modified = fileInfo.lastModified();
+    pendingCacheEntry.size = fileInfo.size();
+    pendingCacheEntry.hash = RenderCache::contentHash(content);
+    pendingCacheEntry.content = content;
+
+    if (splitEditorEnabled && editor2) {
+        editor2->setPlainText(content);
+    }
+
+    finishLoad(filePath);
+
+    // Render the preview only once the editor has had a chance to paint
+    QTimer::singleShot(0, this, [this, content]() {
+        renderPreview(content);
+    });
+}
+
+void MainWindow::onLoadFailed(const QString &error)
+{
+    QString filePath = chunkedLoadPath;
+    cancelLoad();
+
+    QMessageBox::warning(this, tr("Error"), tr("Cannot read file %1:\n%2")
+        .arg(filePath)
+        .arg(error));
+}
+
+void MainWindow::cancelLoad()
+{
+    fileLoader->cancel();
+    endChunkedLoad();
+
+    // A partially loaded buffer must never be saved over the original file
+    loadingFile = true;
+    editor->clear();
+    loadingFile = false;
+    editJournal->reset(QString());
+    preview->updatePreview("");
+
+    currentFilePath.clear();
+    preview->setCurrentFilePath("");
+    editor->setCurrentFilePath("");
+    if (editor2) {
+        editor2->setCurrentFilePath("");
+    }
+    isModified = false;
+    updateWindowTitle();
+    watchOpenFiles();
+}
+
+void MainWindow::finishLoad(const QString &filePath)
+{
     // Ensure both editor and preview are visible
     editor->setVisible(true);
     preview->setVisible(true);
@@ -374,36 +872,112 @@ void MainWindow::loadFile(const QString &filePath)
         editor2->setCurrentFilePath(filePath);
     }
     
+    // Journal edits from here on against the freshly loaded text
+    editJournal->reset(filePath);
+    savedContentHash.clear();
+    watchOpenFiles();
+
     // Reset modified flag when loading a file
     isModified = false;
     updateWindowTitle();
+    linkCheckTimer->start();
+    lineChangeTimer->start();
+    updateBlame();
 }
 
-bool MainWindow::saveFileToPath(const QString &filePath)
+void MainWindow::saveFileToPath(const QString &filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, tr("Error"), tr("Cannot write file %1:\n%2")
-            .arg(filePath)
-            .arg(file.errorString()));
-        return false;
+    // The worker writes a snapshot, so editing can continue during the write
+    fileSaver->save(filePath, editor->toPlainText(), editRevision);
+    watchOpenFiles();
+    statusBar()->showMessage(tr("Saving %1...").arg(QFileInfo(filePath).fileName()));
+
+    // The cached render no longer matches the file on disk
+    renderCache.remove(filePath);
+}
+
+void MainWindow::moveDocument(int id, const QString &filePath)
+{
+    int index = findDocumentById(id);
+    if (index < 0) {
+        return;
+    }
+
+    if (index != activeDocument || viewerMode) {
+        documents[index]->filePath = filePath;
+        updateTabText(index);
+        watchOpenFiles();
+        return;
     }
 
-    QTextStream out(&file);
-    out << editor->toPlainText();
-    file.close();
+    currentFilePath = filePath;
+    updateWindowTitle();
+    watchOpenFiles();
 
     // Set the file path in the editor for relative path calculation
     editor->setCurrentFilePath(filePath);
     if (editor2) {
         editor2->setCurrentFilePath(filePath);
     }
+    preview->setCurrentFilePath(filePath);
 
-    // Reset modified flag after successful save
-    isModified = false;
-    updateWindowTitle();
+    // Relative links now resolve against the new location
+    linkCheckTimer->start();
+    lineChangeTimer->start();
+    updateBlame();
+}
 
-    return true;
+void MainWindow::onFileSaved(const QString &filePath, quint64 revision, qint64 elapsedMs, const QByteArray &contentHash)
+{
+    statusBar()->showMessage(tr("Saved %1 (%2 ms)")
+        .arg(QFileInfo(filePath).fileName())
+        .arg(elapsedMs), 3000);
+
+    if (saveAsTargets.contains(filePath)) {
+        moveDocument(saveAsTargets.take(filePath), filePath);
+    }
+
+    workspaceIndexer->updateFile(filePath);
+    gitWidget->notifyFileChanged(filePath);
+
+    if (viewerMode || filePath != currentFilePath) {
+        // Saved from a tab that is no longer active
+        int index = findDocument(filePath);
+        if (index < 0) {
+            return;
+        }
+        Document *document = documents[index];
+        document->savedContentHash = contentHash;
+        if (revision == document->revision) {
+            document->modified = false;
+            updateTabText(index);
+            document->journal->reset(filePath);
+        } else {
+            document->journal->checkpoint();
+        }
+        return;
+    }
+    savedContentHash = contentHash;
+
+    if (revision == editRevision) {
+        isModified = false;
+        updateWindowTitle();
+        editJournal->reset(filePath);
+    } else {
+        // Edits made while the write was running are still unsaved, but the
+        // journal's base on disk has just been replaced
+        editJournal->checkpoint();
+    }
+}
+
+void MainWindow::onFileSaveFailed(const QString &filePath, const QString &error)
+{
+    // A failed Save As leaves the document where it was
+    saveAsTargets.remove(filePath);
+    statusBar()->clearMessage();
+    QMessageBox::warning(this, tr("Error"), tr("Cannot write file %1:\n%2")
+        .arg(filePath)
+        .arg(error));
 }
 
 void MainWindow::toggleSplitEditor()
@@ -424,10 +998,22 @@ void MainWindow::updateEditorLayout()
     // This automatically removes them from the splitter
     editor->setParent(nullptr);
     editor2->setParent(nullptr);
+    largeFileViewer->setParent(nullptr);
     preview->setParent(nullptr);
     editorViewSplitter->setParent(nullptr);
 
-    if (splitEditorEnabled) {
+    if (viewerMode) {
+        // Read-only viewer mode: viewer | preview
+        editorSplitter->addWidget(largeFileViewer);
+        editorSplitter->addWidget(preview);
+        editorSplitter->setStretchFactor(0, 1);
+        editorSplitter->setStretchFactor(1, 1);
+
+        largeFileViewer->setVisible(true);
+        preview->setVisible(true);
+
+        editorSplitter->setSizes(QList<int>() << 600 << 600);
+    } else if (splitEditorEnabled) {
         // Split editor mode: editor1 | editor2 | preview
         editorViewSplitter->addWidget(editor);
         editorViewSplitter->addWidget(editor2);
@@ -534,8 +1120,197 @@ void MainWindow::toggleGitPanel()
     }
 }
 
+void MainWindow::toggleSearchPanel()
+{
+    bool visible = !searchPanel->isVisible();
+    searchPanel->setVisible(visible);
+    searchAction->setChecked(visible);
+
+    if (visible) {
+        // Without an opened folder, the first search indexes the file browser's root
+        if (workspaceIndexer->rootPath().isEmpty()) {
+            workspaceIndexer->setRootPath(fileBrowser->getRootPath());
+        }
+        searchPanel->focusQuery();
+    }
+}
+
+void MainWindow::toggleBacklinksPanel()
+{
+    bool visible = !backlinksPanel->isVisible();
+    if (visible && workspaceIndexer->rootPath().isEmpty()) {
+        workspaceIndexer->setRootPath(fileBrowser->getRootPath());
+    }
+    backlinksPanel->setVisible(visible);
+    backlinksAction->setChecked(visible);
+}
+
+void MainWindow::toggleOutlinePanel()
+{
+    bool visible = !outlinePanel->isVisible();
+    outlinePanel->setVisible(visible);
+    outlineAction->setChecked(visible);
+    if (visible) {
+        outlinePanel->focusFilter();
+    }
+}
+
+void MainWindow::toggleHideIgnored(bool hide)
+{
+    fileBrowser->setHideIgnored(hide);
+    QSettings settings;
+    settings.setValue("fileBrowser/hideIgnored", hide);
+}
+
+void MainWindow::jumpToHeading(int position)
+{
+    if (viewerMode || position >= editor->document()->characterCount()) {
+        return;
+    }
+
+    // Heading at the top of the view rather than wherever ensureCursorVisible puts it
+    QTextCursor cursor(editor->document());
+    cursor.setPosition(position);
+    editor->setTextCursor(cursor);
+    QTextBlock block = cursor.block();
+    QScrollBar *scrollBar = editor->verticalScrollBar();
+    scrollBar->setValue(qMin(block.firstLineNumber(), scrollBar->maximum()));
+    editor->setFocus();
+}
+
+void MainWindow::checkLinks()
+{
+    if (viewerMode || loadingFile || fileLoader->isRunning()) {
+        return;
+    }
+    if (editor->document()->characterCount() > MaxLinkCheckLength) {
+        editor->setProblemMarkers(QVector<MarkdownEditor::ProblemMarker>());
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<MarkdownEditor::ProblemMarker> markers;
+    const QVector<LinkChecker::Problem> problems = linkChecker->check(currentFilePath, editor->toPlainText());
+    for (const LinkChecker::Problem &problem : problems) {
+        MarkdownEditor::ProblemMarker marker;
+        marker.position = problem.position;
+        marker.length = problem.length;
+        marker.message = problem.message;
+        markers.append(marker);
+    }
+    editor->setProblemMarkers(markers);
+
+    Diagnostics::recordDuration("Link check", timer.nsecsElapsed() / 1000);
+}
+
+void MainWindow::updateLineChanges()
+{
+    if (viewerMode || loadingFile || fileLoader->isRunning()) {
+        return;
+    }
+    lineChangeTracker->update(currentFilePath, editor->toPlainText());
+}
+
+void MainWindow::updateBlame()
+{
+    // Only for as long as the git panel has found a repository
+    if (!blameAction->isChecked() || gitWidget->repositoryRoot().isEmpty()) {
+        editor->setBlameShown(false);
+        return;
+    }
+    editor->setBlameShown(true);
+    gitBlame->request(currentFilePath);
+    editor->setBlame(gitBlame->lines(currentFilePath));
+}
+
+void MainWindow::renderPreview(const QString &markdown)
+{
+    previewGeneration = preview->updatePreview(markdown);
+    previewDocumentId = activeDocument >= 0 ? documents[activeDocument]->id : 0;
+    previewRevision = editRevision;
+}
+
+void MainWindow::onPreviewRendered(quint64 generation, const QString &markdown, const QString &html)
+{
+    // Kept with the tab, so switching back to it needs no conversion
+    int index = generation == previewGeneration ? findDocumentById(previewDocumentId) : -1;
+    if (index >= 0) {
+        Document *document = documents[index];
+        document->html = html;
+        document->htmlRevision = previewRevision;
+        document->hasHtml = true;
+    }
+
+    if (pendingCachePath.isEmpty() || markdown != pendingCacheEntry.content) {
+        return;
+    }
+
+    pendingCacheEntry.html = html;
+    renderCache.insert(pendingCachePath, pendingCacheEntry);
+    pendingCachePath.clear();
+    pendingCacheEntry = RenderCache::Entry();
+}
+
+void MainWindow::populateThemeMenu()
+{
+    // Rebuilt on every show so newly dropped theme files appear without a restart
+    themeMenu->clear();
+
+    QString activeTheme = preview->themeFile();
+
+    QAction *defaultAction = themeMenu->addAction(tr("Default"));
+    defaultAction->setCheckable(true);
+    defaultAction->setChecked(activeTheme.isEmpty());
+    connect(defaultAction, &QAction::triggered, this, [this]() { applyTheme(QString()); });
+
+    QDir themesDir(PreviewWidget::themesDirectory());
+    const QFileInfoList themes = themesDir.entryInfoList(QStringList() << "*.css", QDir::Files, QDir::Name);
+    if (!themes.isEmpty()) {
+        themeMenu->addSeparator();
+    }
+    for (const QFileInfo &theme : themes) {
+        QString themePath = theme.absoluteFilePath();
+        QAction *action = themeMenu->addAction(theme.completeBaseName());
+        action->setCheckable(true);
+        action->setChecked(themePath == activeTheme);
+        connect(action, &QAction::triggered, this, [this, themePath]() { applyTheme(themePath); });
+    }
+
+    themeMenu->addSeparator();
+    QAction *loadAction = themeMenu->addAction(tr("Load Theme File..."));
+    connect(loadAction, &QAction::triggered, this, &MainWindow::loadThemeFile);
+}
+
+void MainWindow::loadThemeFile()
+{
+    QString filePath = QFileDialog::getOpenFileName(
+        this,
+        tr("Load Preview Theme"),
+        PreviewWidget::themesDirectory(),
+        tr("Style Sheets (*.css);;All Files (*)")
+    );
+
+    if (!filePath.isEmpty()) {
+        applyTheme(filePath);
+    }
+}
+
+void MainWindow::applyTheme(const QString &filePath)
+{
+    if (!preview->setThemeFile(filePath)) {
+        QMessageBox::warning(this, tr("Error"), tr("Cannot read theme file %1").arg(filePath));
+        return;
+    }
+
+    QSettings().setValue("preview/themeFile", filePath);
+}
+
 void MainWindow::documentModified()
 {
+    editRevision++;
+
     if (!isModified) {
         isModified = true;
         updateWindowTitle();
@@ -558,6 +1333,187 @@ void MainWindow::updateWindowTitle()
     }
     
     setWindowTitle(title);
+
+    if (activeDocument >= 0 && !viewerMode) {
+        updateTabText(activeDocument);
+    }
+    backlinksPanel->setFilePath(currentFilePath);
+}
+
+void MainWindow::showDiagnostics()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Diagnostics"));
+    dialog.resize(520, 400);
+
+    QPlainTextEdit *reportView = new QPlainTextEdit(&dialog);
+    reportView->setReadOnly(true);
+    reportView->setLineWrapMode(QPlainTextEdit::NoWrap);
+    reportView->setPlainText(Diagnostics::report());
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    QPushButton *refreshButton = buttons->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    QPushButton *resetButton = buttons->addButton(tr("Reset"), QDialogButtonBox::ResetRole);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(refreshButton, &QPushButton::clicked, reportView, [reportView]() {
+        reportView->setPlainText(Diagnostics::report());
+    });
+    connect(resetButton, &QPushButton::clicked, reportView, [reportView]() {
+        Diagnostics::reset();
+        reportView->setPlainText(Diagnostics::report());
+    });
+
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    layout->addWidget(reportView);
+    layout->addWidget(buttons);
+
+    dialog.exec();
+}
+
+void MainWindow::watchOpenFiles()
+{
+    // The viewer maps the file and never edits it, so it is not merged into
+    QStringList paths;
+    for (int i = 0; i < documents.size(); ++i) {
+        QString path = documentPath(i);
+        if (!path.isEmpty() && QFileInfo::exists(path)) {
+            paths.append(path);
+        }
+    }
+
+    // Only the difference is applied; files dropped by the watcher are added back
+    QStringList watched = fileWatcher->files();
+    QStringList removed;
+    for (const QString &path : watched) {
+        if (!paths.contains(path)) {
+            removed.append(path);
+        }
+    }
+    if (!removed.isEmpty()) {
+        fileWatcher->removePaths(removed);
+    }
+    QStringList added;
+    for (const QString &path : paths) {
+        if (!watched.contains(path)) {
+            added.append(path);
+        }
+    }
+    if (!added.isEmpty()) {
+        fileWatcher->addPaths(added);
+    }
+}
+
+void MainWindow::onFileChangedOnDisk(const QString &filePath)
+{
+    if (viewerMode || filePath != currentFilePath) {
+        // Merged when the tab is next shown
+        int index = findDocument(filePath);
+        if (index >= 0) {
+            documents[index]->changedOnDisk = true;
+        }
+        return;
+    }
+
+    // Writers that replace the file drop it from the watcher; settle, then re-add
+    externalChangeTimer->start();
+}
+
+void MainWindow::reloadChangedFile()
+{
+    if (currentFilePath.isEmpty() || viewerMode || fileLoader->isRunning()) {
+        return;
+    }
+    watchOpenFiles();
+
+    // Our own save may still be reporting back; look again once it has
+    if (fileSaver->isSaving()) {
+        externalChangeTimer->start();
+        return;
+    }
+
+    QString content;
+    if (!FileDecoder::readFile(currentFilePath, &content, nullptr, FileDecoder::Copy)) {
+        // Deleted or mid-replace; a later change notification will bring it back
+        return;
+    }
+
+    QByteArray hash = RenderCache::contentHash(content);
+    if (hash == savedContentHash) {
+        return;
+    }
+
+    if (isModified) {
+        QMessageBox::StandardButton reply = QMessageBox::question(this,
+            tr("File Changed on Disk"),
+            tr("%1 was changed by another program. Reload it and discard your unsaved changes?")
+                .arg(QFileInfo(currentFilePath).fileName()),
+            QMessageBox::Yes | QMessageBox::No);
+        if (reply != QMessageBox::Yes) {
+            // Only ask once per external change
+            savedContentHash = hash;
+            return;
+        }
+    }
+
+    // Patch only the changed lines, so cursor, scroll and undo history survive
+    QStringList oldLines = editor->toPlainText().split(QLatin1Char('\n'));
+    QStringList newLines = content.split(QLatin1Char('\n'));
+    QVector<LineDiff::Hunk> hunks = LineDiff::diff(oldLines, newLines);
+
+    loadingFile = true;
+    editor->applyLineChanges(hunks, newLines);
+    loadingFile = false;
+
+    if (!hunks.isEmpty()) {
+        renderPreview(content);
+        statusBar()->showMessage(tr("Reloaded %1 (%2 changed regions)")
+            .arg(QFileInfo(currentFilePath).fileName())
+            .arg(hunks.size()), 3000);
+    }
+
+    renderCache.remove(currentFilePath);
+    savedContentHash = hash;
+    isModified = false;
+    updateWindowTitle();
+    editJournal->reset(currentFilePath);
+}
+
+void MainWindow::recoverUnsavedChanges()
+{
+    for (const QString &journalPath : EditJournal::pendingJournals()) {
+        EditJournal::Recovery recovery;
+        QString error;
+        if (!EditJournal::replay(journalPath, &recovery, &error)) {
+            qWarning("Discarding edit journal %s: %s", qPrintable(journalPath), qPrintable(error));
+            EditJournal::remove(journalPath);
+            continue;
+        }
+
+        QString name = recovery.filePath.isEmpty()
+            ? tr("an untitled document")
+            : QFileInfo(recovery.filePath).fileName();
+        QMessageBox::StandardButton reply = QMessageBox::question(this,
+            tr("Recover Unsaved Changes"),
+            tr("Markdown Editor did not shut down cleanly. Recover unsaved changes to %1?").arg(name),
+            QMessageBox::Yes | QMessageBox::No);
+        EditJournal::remove(journalPath);
+
+        if (reply == QMessageBox::Yes) {
+            // Each recovered document gets its own tab
+            useBlankDocument();
+            preview->setCurrentFilePath(recovery.filePath);
+            loadingFile = true;
+            editor->setPlainText(recovery.content);
+            loadingFile = false;
+            renderPreview(recovery.content);
+            finishLoad(recovery.filePath);
+
+            // The recovered text is not on disk yet
+            editJournal->reset(recovery.filePath, false);
+            isModified = true;
+            updateWindowTitle();
+        }
+    }
 }
 
 void MainWindow::quitApplication()
@@ -567,27 +1523,422 @@ void MainWindow::quitApplication()
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    if (isModified) {
-        QMessageBox::StandardButton reply;
-        reply = QMessageBox::question(this, 
-                                     tr("Unsaved Changes"),
-                                     tr("You have unsaved changes. Do you want to save before closing?"),
-                                     QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
-        
-        if (reply == QMessageBox::Save) {
-            saveFile();
-            // Check if file was actually saved (user might have cancelled save dialog)
-            if (isModified) {
-                event->ignore();
-                return;
-            }
-            event->accept();
-        } else if (reply == QMessageBox::Discard) {
-            event->accept();
-        } else {
+    // Let a save that is still being written finish first
+    fileSaver->waitForFinished();
+    storeActiveDocument();
+
+    for (int i = 0; i < documents.size(); ++i) {
+        if (!documents[i]->modified) {
+            continue;
+        }
+        activateDocument(i);
+        if (!confirmCloseActiveDocument()) {
             event->ignore();
+            return;
+        }
+    }
+    event->accept();
+
+    // A clean exit leaves nothing to recover
+    for (Document *document : documents) {
+        document->journal->discard();
+    }
+}
+
+bool MainWindow::confirmCloseActiveDocument()
+{
+    if (!isModified) {
+        return true;
+    }
+
+    QString name = currentFilePath.isEmpty() ? tr("Untitled") : QFileInfo(currentFilePath).fileName();
+    QMessageBox::StandardButton reply;
+    reply = QMessageBox::question(this,
+                                 tr("Unsaved Changes"),
+                                 tr("%1 has unsaved changes. Do you want to save before closing?").arg(name),
+                                 QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
+
+    if (reply == QMessageBox::Save) {
+        saveFile();
+        fileSaver->waitForFinished();
+        // Check if file was actually saved (user might have cancelled save dialog)
+        return !isModified;
+    }
+    return reply == QMessageBox::Discard;
+}
+
+int MainWindow::addDocument(const QString &text)
+{
+    Document *document = new Document;
+    document->id = ++nextDocumentId;
+    document->textDocument = editor->createDocument(text, this);
+
+    // Unsaved edits are journaled so they survive a crash
+    document->journal = new EditJournal(document->textDocument, this);
+    attachTextDocument(document);
+
+    documents.append(document);
+    int index;
+    {
+        QSignalBlocker blocker(tabBar);
+        index = tabBar->addTab(QString());
+    }
+    updateTabText(index);
+    return index;
+}
+
+int MainWindow::findDocumentById(int id) const
+{
+    for (int i = 0; i < documents.size(); ++i) {
+        if (documents[i]->id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString MainWindow::documentPath(int index) const
+{
+    return (index == activeDocument && !viewerMode) ? currentFilePath : documents[index]->filePath;
+}
+
+int MainWindow::findDocument(const QString &filePath) const
+{
+    QString absolutePath = QFileInfo(filePath).absoluteFilePath();
+    for (int i = 0; i < documents.size(); ++i) {
+        QString path = documentPath(i);
+        if (!path.isEmpty() && QFileInfo(path).absoluteFilePath() == absolutePath) {
+            return i;
         }
+    }
+    return -1;
+}
+
+void MainWindow::activateDocument(int index)
+{
+    if (viewerMode) {
+        closeViewer();
+    }
+    if (index == activeDocument) {
+        return;
+    }
+
+    int previous = activeDocument;
+    storeActiveDocument();
+    activeDocument = index;
+    showActiveDocument();
+
+    // Rendered in the background, so switching back needs no conversion
+    if (previous >= 0) {
+        prerenderDocument(documents[previous]);
+    }
+    enforceMemoryBudget();
+}
+
+void MainWindow::useBlankDocument()
+{
+    // An untouched untitled tab is reused rather than left behind empty
+    if (activeDocument >= 0 && !viewerMode && currentFilePath.isEmpty() && !isModified
+            && editor->document()->isEmpty()) {
+        return;
+    }
+    activateDocument(addDocument(QString()));
+}
+
+void MainWindow::storeActiveDocument()
+{
+    // In viewer mode the state was stored when the viewer opened
+    if (activeDocument < 0 || viewerMode) {
+        return;
+    }
+
+    Document *document = documents[activeDocument];
+    document->filePath = currentFilePath;
+    document->modified = isModified;
+    document->revision = editRevision;
+    document->savedContentHash = savedContentHash;
+    document->cursorPosition = editor->textCursor().position();
+    document->scrollValue = editor->verticalScrollBar()->value();
+    document->lastUsed = ++useCounter;
+}
+
+void MainWindow::showActiveDocument()
+{
+    Document *document = documents[activeDocument];
+    if (!document->textDocument) {
+        restoreTextDocument(document);
+    }
+    document->lastUsed = ++useCounter;
+
+    loadingFile = true;
+    editor->setProblemMarkers(QVector<MarkdownEditor::ProblemMarker>());
+    editor->setLineChanges(QVector<LineDiff::Hunk>());
+    editor->setDocument(document->textDocument);
+    loadingFile = false;
+    outlinePanel->setHighlighter(editor->documentHighlighter());
+
+    QTextCursor cursor(document->textDocument);
+    cursor.setPosition(qBound(0, document->cursorPosition, document->textDocument->characterCount() - 1));
+    editor->setTextCursor(cursor);
+    editor->verticalScrollBar()->setValue(document->scrollValue);
+    undoAction->setEnabled(document->textDocument->isUndoAvailable());
+    redoAction->setEnabled(document->textDocument->isRedoAvailable());
+
+    currentFilePath = document->filePath;
+    isModified = document->modified;
+    editRevision = document->revision;
+    savedContentHash = document->savedContentHash;
+    editJournal = document->journal;
+    pendingCachePath.clear();
+
+    editor->setCurrentFilePath(currentFilePath);
+    editor2->setCurrentFilePath(currentFilePath);
+    preview->setCurrentFilePath(currentFilePath);
+
+    if (document->hasHtml && document->htmlRevision == document->revision) {
+        Diagnostics::increment("Documents: switches with prerendered html");
+        preview->showHtml(document->html);
     } else {
-        event->accept();
+        Diagnostics::increment("Documents: switches needing a render");
+        renderPreview(document->textDocument->toPlainText());
+    }
+
+    if (splitEditorEnabled) {
+        loadingFile = true;
+        editor2->setPlainText(document->textDocument->toPlainText());
+        loadingFile = false;
+    }
+
+    {
+        QSignalBlocker blocker(tabBar);
+        tabBar->setCurrentIndex(activeDocument);
+    }
+    updateWindowTitle();
+    watchOpenFiles();
+    linkCheckTimer->start();
+    lineChangeTimer->start();
+    updateBlame();
+
+    if (document->changedOnDisk) {
+        document->changedOnDisk = false;
+        externalChangeTimer->start();
+    }
+}
+
+void MainWindow::onTabChanged(int index)
+{
+    if (index >= 0) {
+        activateDocument(index);
+    }
+}
+
+void MainWindow::onTabMoved(int from, int to)
+{
+    documents.move(from, to);
+
+    if (activeDocument == from) {
+        activeDocument = to;
+    } else if (from < activeDocument && to >= activeDocument) {
+        activeDocument--;
+    } else if (from > activeDocument && to <= activeDocument) {
+        activeDocument++;
+    }
+}
+
+void MainWindow::closeTab(int index)
+{
+    closeDocument(index);
+}
+
+void MainWindow::closeCurrentTab()
+{
+    // Closing while viewing a large file leaves the viewer, not the tab under it
+    if (viewerMode) {
+        closeViewer();
+    } else if (activeDocument >= 0) {
+        closeDocument(activeDocument);
+    }
+}
+
+bool MainWindow::closeDocument(int index)
+{
+    if (fileLoader->isRunning()) {
+        cancelLoad();
+    }
+
+    bool modified = (index == activeDocument && !viewerMode) ? isModified : documents[index]->modified;
+    if (modified) {
+        activateDocument(index);
+        if (!confirmCloseActiveDocument()) {
+            return false;
+        }
+    }
+
+    Document *document = documents.takeAt(index);
+    document->journal->discard();
+
+    if (index == activeDocument) {
+        activeDocument = -1;
+    } else if (index < activeDocument) {
+        activeDocument--;
+    }
+    {
+        QSignalBlocker blocker(tabBar);
+        tabBar->removeTab(index);
+    }
+
+    if (documents.isEmpty()) {
+        addDocument(QString());
+    }
+    if (activeDocument < 0) {
+        activateDocument(qMin(index, documents.size() - 1));
+    } else {
+        watchOpenFiles();
+    }
+
+    // Deleted only once the editor shows another document
+    delete document->textDocument;
+    delete document->journal;
+    delete document;
+    return true;
+}
+
+void MainWindow::updateTabText(int index)
+{
+    Document *document = documents[index];
+    bool active = index == activeDocument && !viewerMode;
+    QString path = documentPath(index);
+    bool modified = active ? isModified : document->modified;
+
+    QString text = path.isEmpty() ? tr("Untitled") : QFileInfo(path).fileName();
+    if (modified) {
+        text += " *";
+    }
+    tabBar->setTabText(index, text);
+    tabBar->setTabToolTip(index, path);
+}
+
+void MainWindow::attachTextDocument(Document *document)
+{
+    EditJournal *journal = document->journal;
+    connect(document->textDocument, &QTextDocument::contentsChange, journal,
+            [this, journal](int position, int charsRemoved, int charsAdded) {
+        if (!loadingFile) {
+            journal->recordChange(position, charsRemoved, charsAdded);
+        }
+    });
+}
+
+void MainWindow::restoreTextDocument(Document *document)
+{
+    document->textDocument = editor->createDocument(document->content, this);
+    document->content.clear();
+    document->journal->setDocument(document->textDocument);
+    attachTextDocument(document);
+}
+
+void MainWindow::evictTextDocument(Document *document)
+{
+    // Layout, highlighting and undo history go; the text stays as a plain string
+    document->content = document->textDocument->toPlainText();
+    document->journal->setDocument(nullptr);
+    delete document->textDocument;
+    document->textDocument = nullptr;
+    Diagnostics::increment("Documents: evicted");
+}
+
+qint64 MainWindow::documentMemory(const Document *document) const
+{
+    qint64 bytes = qint64(document->html.size()) * 2;
+    if (document->textDocument) {
+        // Rough: the text with its highlight formats, plus layout per block
+        bytes += qint64(document->textDocument->characterCount()) * 16
+            + qint64(document->textDocument->blockCount()) * 512;
+    } else {
+        bytes += qint64(document->content.size()) * 2;
+    }
+    return bytes;
+}
+
+void MainWindow::enforceMemoryBudget()
+{
+    qint64 total = 0;
+    QList<Document *> candidates;
+    for (int i = 0; i < documents.size(); ++i) {
+        total += documentMemory(documents[i]);
+        if (i != activeDocument) {
+            candidates.append(documents[i]);
+        }
+    }
+    if (total <= documentMemoryBudget) {
+        return;
+    }
+
+    // Least recently used first; the active tab is never touched
+    std::sort(candidates.begin(), candidates.end(), [](const Document *a, const Document *b) {
+        return a->lastUsed < b->lastUsed;
+    });
+
+    // Modified documents keep their QTextDocument so their undo history survives
+    for (Document *document : candidates) {
+        if (total <= documentMemoryBudget) {
+            return;
+        }
+        if (document->textDocument && !document->modified) {
+            qint64 before = documentMemory(document);
+            evictTextDocument(document);
+            total -= before - documentMemory(document);
+        }
+    }
+
+    // Still over: drop cached renders, they are rebuilt when the tab is shown
+    for (Document *document : candidates) {
+        if (total <= documentMemoryBudget) {
+            return;
+        }
+        if (document->hasHtml) {
+            total -= qint64(document->html.size()) * 2;
+            document->html.clear();
+            document->hasHtml = false;
+        }
+    }
+}
+
+void MainWindow::prerenderDocument(Document *document)
+{
+    if (document->prerendering || (document->hasHtml && document->htmlRevision == document->revision)) {
+        return;
+    }
+    document->prerendering = true;
+
+    QString markdown = document->textDocument ? document->textDocument->toPlainText() : document->content;
+    int id = document->id;
+    quint64 revision = document->revision;
+
+    prerenderPool.start([this, id, revision, markdown]() {
+        QString html = MarkdownConverter::markdownToHtml(markdown);
+        QMetaObject::invokeMethod(this, [this, id, revision, html]() {
+            onDocumentPrerendered(id, revision, html);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::onDocumentPrerendered(int id, quint64 revision, const QString &html)
+{
+    for (Document *document : documents) {
+        if (document->id != id) {
+            continue;
+        }
+        document->prerendering = false;
+
+        // Edited again since, e.g. after switching back and forth
+        if (revision == document->revision) {
+            document->html = html;
+            document->htmlRevision = revision;
+            document->hasHtml = true;
+            Diagnostics::increment("Documents: prerendered");
+            enforceMemoryBudget();
+        }
+        return;
     }
 }
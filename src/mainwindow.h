@@ -7,11 +7,37 @@
 #include <QMenuBar>
 #include <QAction>
 #include <QString>
+#include <QList>
+#include <QHash>
+#include <QByteArray>
+#include <QThreadPool>
 
+#include "rendercache.h"
+
+class QMenu;
+class QProgressBar;
+class QPushButton;
+class QFileSystemWatcher;
+class QTimer;
+class QTabBar;
+class QTextDocument;
 class MarkdownEditor;
 class PreviewWidget;
 class FileBrowser;
 class GitWidget;
+class FileLoader;
+class FileSaver;
+class EditJournal;
+class LargeFileViewer;
+class WorkspaceIndexer;
+class SearchPanel;
+class PathIndex;
+class QuickOpenDialog;
+class BacklinksPanel;
+class OutlinePanel;
+class LinkChecker;
+class LineChangeTracker;
+class GitBlame;
 
 class MainWindow : public QMainWindow
 {
@@ -28,45 +54,173 @@ private slots:
     void newFile();
     void openFile();
     void openFolder();
+    void showQuickOpen();
     void saveFile();
     void saveFileAs();
     void toggleFullScreen();
     void toggleSplitEditor();
     void toggleGitPanel();
+    void toggleSearchPanel();
+    void toggleBacklinksPanel();
+    void toggleOutlinePanel();
+    void toggleHideIgnored(bool hide);
+    void jumpToHeading(int position);
     void onFileSelected(const QString &filePath);
     void documentModified();
     void quitApplication();
+    void populateThemeMenu();
+    void loadThemeFile();
+    void onPreviewRendered(quint64 generation, const QString &markdown, const QString &html);
+    void onLoadChunk(const QString &text);
+    void onLoadFinished();
+    void onLoadFailed(const QString &error);
+    void cancelLoad();
+    void showDiagnostics();
+    void onFileSaved(const QString &filePath, quint64 revision, qint64 elapsedMs, const QByteArray &contentHash);
+    void onFileSaveFailed(const QString &filePath, const QString &error);
+    void recoverUnsavedChanges();
+    void onFileChangedOnDisk(const QString &filePath);
+    void reloadChangedFile();
+    void onTabChanged(int index);
+    void onTabMoved(int from, int to);
+    void closeTab(int index);
+    void closeCurrentTab();
+    void checkLinks();
+    void updateLineChanges();
+    void updateBlame();
 
 private:
+    // An open tab. Inactive tabs keep their text and last render; an unmodified
+    // one may also drop its QTextDocument (layout and highlighting) when the
+    // documents outgrow the memory budget.
+    struct Document
+    {
+        int id = 0;
+        QString filePath;
+        QTextDocument *textDocument = nullptr;  // null while evicted
+        QString content;                        // the text while evicted
+        EditJournal *journal = nullptr;
+        bool modified = false;
+        quint64 revision = 0;
+        QByteArray savedContentHash;
+        QString html;  // render of the text at htmlRevision
+        quint64 htmlRevision = 0;
+        bool hasHtml = false;
+        bool prerendering = false;
+        bool changedOnDisk = false;
+        int cursorPosition = 0;
+        int scrollValue = 0;
+        quint64 lastUsed = 0;
+    };
+
     void createMenuBar();
     void createToolBar();
     void createActions();
     void loadFile(const QString &filePath);
-    bool saveFileToPath(const QString &filePath);
+    void startChunkedLoad(const QString &filePath);
+    void endChunkedLoad();
+    void finishLoad(const QString &filePath);
+    void openInViewer(const QString &filePath);
+    void closeViewer();
+    void setViewerMode(bool enabled);
+    void watchOpenFiles();
+    int addDocument(const QString &text);
+    int findDocument(const QString &filePath) const;
+    int findDocumentById(int id) const;
+    // The active document's path lives in currentFilePath until it is switched away from
+    QString documentPath(int index) const;
+    void activateDocument(int index);
+    void useBlankDocument();
+    void storeActiveDocument();
+    void showActiveDocument();
+    bool confirmCloseActiveDocument();
+    bool closeDocument(int index);
+    void updateTabText(int index);
+    void attachTextDocument(Document *document);
+    void restoreTextDocument(Document *document);
+    void evictTextDocument(Document *document);
+    qint64 documentMemory(const Document *document) const;
+    void enforceMemoryBudget();
+    void prerenderDocument(Document *document);
+    void onDocumentPrerendered(int id, quint64 revision, const QString &html);
+    void saveFileToPath(const QString &filePath);
+    // Renders the active document's text; the result is kept with its tab
+    void renderPreview(const QString &markdown);
+    // Points a document at the path a Save As has just written
+    void moveDocument(int id, const QString &filePath);
     void updateEditorLayout();
     void syncEditors();
     void updateWindowTitle();
+    void applyTheme(const QString &filePath);
 
     // Widgets
     QSplitter *mainSplitter;
+    QSplitter *sidebarSplitter;  // File browser above search, backlinks and outline
     QSplitter *editorSplitter;
     QSplitter *editorViewSplitter;  // For split editor view
+    QTabBar *tabBar;
     FileBrowser *fileBrowser;
+    SearchPanel *searchPanel;
+    BacklinksPanel *backlinksPanel;
+    OutlinePanel *outlinePanel;
+    WorkspaceIndexer *workspaceIndexer;
+    PathIndex *pathIndex;
+    QuickOpenDialog *quickOpenDialog;
     MarkdownEditor *editor;
     MarkdownEditor *editor2;  // Second editor for split view
     PreviewWidget *preview;
     GitWidget *gitWidget;
+    FileLoader *fileLoader;
+    FileSaver *fileSaver;
+    EditJournal *editJournal;  // The active document's
+    QFileSystemWatcher *fileWatcher;
+    QTimer *externalChangeTimer;
+    QTimer *linkCheckTimer;  // Checks links once typing pauses
+    LinkChecker *linkChecker;
+    QTimer *lineChangeTimer;  // Compares with HEAD once typing pauses
+    LineChangeTracker *lineChangeTracker;
+    GitBlame *gitBlame;
+    QProgressBar *loadProgressBar;
+    QPushButton *cancelLoadButton;
+    LargeFileViewer *largeFileViewer;
 
     // State
     bool splitEditorEnabled;
     bool isModified;
+    bool loadingFile;
+    bool viewerMode;  // A file above viewerThreshold is shown read-only
+    qint64 viewerThreshold;
+    quint64 editRevision;  // Bumped on every edit, to match finished saves against
+    QByteArray savedContentHash;  // Of the last text we wrote, to ignore our own saves
+    QHash<QString, int> saveAsTargets;  // Path being written -> id of the document moving there
+    // The last render requested for the active document, and the edit it shows
+    quint64 previewGeneration;
+    int previewDocumentId;
+    quint64 previewRevision;
+
+    // Rendered output of recently opened files, for instant switching
+    RenderCache renderCache;
+    QString pendingCachePath;
+    QString chunkedLoadPath;
+    RenderCache::Entry pendingCacheEntry;
+
+    // Open documents in tab order; the active one is shown in the editor and its
+    // state lives in the members above until another tab is activated
+    QList<Document *> documents;
+    int activeDocument;
+    int nextDocumentId;
+    quint64 useCounter;
+    qint64 documentMemoryBudget;
+    QThreadPool prerenderPool;  // Renders inactive tabs one at a time
 
     // Actions
     QAction *newAction;
     QAction *openAction;
     QAction *openFolderAction;
+    QAction *quickOpenAction;
     QAction *saveAction;
     QAction *saveAsAction;
+    QAction *closeTabAction;
     QAction *undoAction;
     QAction *redoAction;
     QAction *cutAction;
@@ -77,7 +231,14 @@ private:
     QAction *exitFullScreenAction;
     QAction *splitEditorAction;
     QAction *gitPanelAction;
+    QAction *searchAction;
+    QAction *backlinksAction;
+    QAction *outlineAction;
+    QAction *blameAction;
+    QAction *hideIgnoredAction;
+    QAction *diagnosticsAction;
     QAction *quitAction;
+    QMenu *themeMenu;
 
     QString currentFilePath;
 };
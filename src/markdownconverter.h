@@ -0,0 +1,28 @@
+#ifndef MARKDOWNCONVERTER_H
+#define MARKDOWNCONVERTER_H
+
+#include <QString>
+#include <QStringList>
+
+// Stateless markdown to html conversion; safe to call from the render thread
+class MarkdownConverter
+{
+public:
+    static QString markdownToHtml(const QString &markdown);
+
+private:
+    static QString processEmojis(const QString &text);
+    static QString processCodeBlocks(const QString &text);
+    static QString processTables(const QString &text);
+    static QString convertTableToHtml(const QStringList &tableLines);
+    static QString processYamlFrontMatter(const QString &text);
+    static QString escapeHtmlInText(const QString &text);
+    static QString restoreEscapedHtml(const QString &text);
+    static QString processBackslashEscapes(const QString &text);
+    static QString processAutolinks(const QString &text);
+    static QString processBlockquotes(const QString &text);
+    static QString processLists(const QString &text);
+    static QString processInlineCode(const QString &text);
+};
+
+#endif // MARKDOWNCONVERTER_H
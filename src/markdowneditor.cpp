@@ -1,5 +1,6 @@
 #include "markdowneditor.h"
 #include "markdownhighlighter.h"
+#include "diagnostics.h"
 
 #include <QFont>
 #include <QScrollBar>
@@ -11,9 +12,68 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QTextCursor>
+#include <QTextBlock>
+#include <QTimer>
+#include <QScreen>
+#include <QHelpEvent>
+#include <QToolTip>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QDateTime>
+#include <algorithm>
+
+// Strip left of the text, painted by the editor
+class EditorGutter : public QWidget
+{
+public:
+    explicit EditorGutter(MarkdownEditor *editor)
+        : QWidget(editor)
+        , editor(editor)
+    {
+    }
+
+protected:
+    bool event(QEvent *event) override
+    {
+        if (event->type() == QEvent::ToolTip) {
+            QHelpEvent *helpEvent = static_cast<QHelpEvent *>(event);
+            QString text = editor->gutterToolTip(helpEvent->pos());
+            if (text.isEmpty()) {
+                QToolTip::hideText();
+            } else {
+                QToolTip::showText(helpEvent->globalPos(), text, this);
+            }
+            return true;
+        }
+        return QWidget::event(event);
+    }
+
+    void paintEvent(QPaintEvent *event) override
+    {
+        editor->paintGutter(event);
+    }
+
+private:
+    MarkdownEditor *editor;
+};
+
+namespace {
+
+const int ChangeMarkerWidth = 4;
+// Room for the date and the start of the author's name
+const int BlameColumnChars = 24;
+
+} // namespace
 
 MarkdownEditor::MarkdownEditor(QWidget *parent)
     : QPlainTextEdit(parent)
+    , pendingScrollPercentage(0.0)
+    , scrollSyncPending(false)
+    , scrollEvents(0)
+    , mergedScrollEvents(0)
+    , deliveredScrollUpdates(0)
+    , lineChangesShown(false)
+    , blameShown(false)
 {
     // Set a monospace font
     QFont font("Monospace", 11);
@@ -27,11 +87,20 @@ MarkdownEditor::MarkdownEditor(QWidget *parent)
     // Enable line wrapping
     setLineWrapMode(QPlainTextEdit::WidgetWidth);
 
-    // Create syntax highlighter
-    highlighter = new MarkdownHighlighter(document());
+    // Owned by the document, so it follows it through setDocument
+    new MarkdownHighlighter(document());
     
     // Enable drag and drop
     setAcceptDrops(true);
+
+    scrollSyncTimer = new QTimer(this);
+    scrollSyncTimer->setSingleShot(true);
+    scrollSyncTimer->setTimerType(Qt::PreciseTimer);
+    connect(scrollSyncTimer, &QTimer::timeout, this, &MarkdownEditor::flushScrollPercentage);
+
+    gutter = new EditorGutter(this);
+    connect(this, &MarkdownEditor::updateRequest, this, &MarkdownEditor::updateGutter);
+    updateGutterGeometry();
 }
 
 MarkdownEditor::~MarkdownEditor()
@@ -44,12 +113,66 @@ void MarkdownEditor::scrollContentsBy(int dx, int dy)
     
     // Calculate scroll percentage
     QScrollBar *vScrollBar = verticalScrollBar();
+    double percentage = 0.0;
     if (vScrollBar->maximum() > 0) {
-        double percentage = static_cast<double>(vScrollBar->value()) / vScrollBar->maximum();
-        emit scrollPercentageChanged(percentage);
-    } else {
-        emit scrollPercentageChanged(0.0);
+        percentage = static_cast<double>(vScrollBar->value()) / vScrollBar->maximum();
+    }
+    scrollEvents++;
+
+    if (scrollSyncTimer->isActive()) {
+        // Already delivered one this frame; keep only the latest for the next
+        if (scrollSyncPending) {
+            mergedScrollEvents++;
+        }
+        pendingScrollPercentage = percentage;
+        scrollSyncPending = true;
+        return;
+    }
+
+    deliveredScrollUpdates++;
+    emit scrollPercentageChanged(percentage);
+    scrollSyncTimer->start(frameInterval());
+}
+
+void MarkdownEditor::flushScrollPercentage()
+{
+    // Every delivered update starts the timer, so this runs once per frame of scrolling
+    reportScrollCounts();
+    if (!scrollSyncPending) {
+        return;
+    }
+
+    scrollSyncPending = false;
+    deliveredScrollUpdates++;
+    emit scrollPercentageChanged(pendingScrollPercentage);
+
+    // Keep throttling while the scroll is still going
+    scrollSyncTimer->start(frameInterval());
+}
+
+void MarkdownEditor::reportScrollCounts()
+{
+    if (scrollEvents) {
+        Diagnostics::increment("Scroll sync: scroll events", scrollEvents);
+    }
+    if (mergedScrollEvents) {
+        Diagnostics::increment("Scroll sync: merged events", mergedScrollEvents);
+    }
+    if (deliveredScrollUpdates) {
+        Diagnostics::increment("Scroll sync: delivered updates", deliveredScrollUpdates);
+    }
+    scrollEvents = 0;
+    mergedScrollEvents = 0;
+    deliveredScrollUpdates = 0;
+}
+
+int MarkdownEditor::frameInterval() const
+{
+    qreal refreshRate = screen() ? screen()->refreshRate() : 60.0;
+    if (refreshRate <= 0) {
+        refreshRate = 60.0;
     }
+    return qBound(4, qRound(1000.0 / refreshRate), 50);
 }
 
 void MarkdownEditor::setCurrentFilePath(const QString &path)
@@ -62,6 +185,321 @@ QString MarkdownEditor::getCurrentFilePath() const
     return currentFilePath;
 }
 
+QTextDocument *MarkdownEditor::createDocument(const QString &text, QObject *parent) const
+{
+    QTextDocument *doc = new QTextDocument(parent);
+    doc->setDocumentLayout(new QPlainTextDocumentLayout(doc));
+    doc->setDefaultFont(font());
+    doc->setDefaultTextOption(document()->defaultTextOption());
+    new MarkdownHighlighter(doc);
+
+    // Also resets the undo history
+    doc->setPlainText(text);
+    return doc;
+}
+
+MarkdownHighlighter *MarkdownEditor::documentHighlighter() const
+{
+    return document()->findChild<MarkdownHighlighter *>();
+}
+
+void MarkdownEditor::appendText(const QString &text)
+{
+    // Unlike appendPlainText this adds no paragraph break and leaves the view alone
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+}
+
+void MarkdownEditor::applyLineChanges(const QVector<LineDiff::Hunk> &hunks, const QStringList &newLines)
+{
+    if (hunks.isEmpty()) {
+        return;
+    }
+
+    int scrollValue = verticalScrollBar()->value();
+    QTextDocument *doc = document();
+
+    // The view's cursor is a separate QTextCursor, so it moves with the text around it
+    QTextCursor cursor(doc);
+    cursor.beginEditBlock();
+
+    // Back to front, so earlier line numbers stay valid
+    for (int i = hunks.size() - 1; i >= 0; --i) {
+        const LineDiff::Hunk &hunk = hunks[i];
+        QString text = newLines.mid(hunk.newStart, hunk.newCount).join(QLatin1Char('\n'));
+        int blockCount = doc->blockCount();
+
+        if (hunk.oldCount > 0 && hunk.newCount > 0) {
+            // Replace the lines, keeping the separator after the last one
+            cursor.setPosition(doc->findBlockByNumber(hunk.oldStart).position());
+            QTextBlock last = doc->findBlockByNumber(hunk.oldStart + hunk.oldCount - 1);
+            cursor.setPosition(last.position() + last.length() - 1, QTextCursor::KeepAnchor);
+            cursor.insertText(text);
+        } else if (hunk.oldCount > 0) {
+            if (hunk.oldStart + hunk.oldCount < blockCount) {
+                // Remove the lines along with their trailing separators
+                cursor.setPosition(doc->findBlockByNumber(hunk.oldStart).position());
+                cursor.setPosition(doc->findBlockByNumber(hunk.oldStart + hunk.oldCount).position(),
+                                   QTextCursor::KeepAnchor);
+            } else if (hunk.oldStart > 0) {
+                // Trailing lines go with the separator before them
+                QTextBlock previous = doc->findBlockByNumber(hunk.oldStart - 1);
+                cursor.setPosition(previous.position() + previous.length() - 1);
+                cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+            } else {
+                cursor.setPosition(0);
+                cursor.movePosition(QTextCursor::End, QTextCursor::KeepAnchor);
+            }
+            cursor.removeSelectedText();
+        } else if (hunk.newCount > 0) {
+            if (hunk.oldStart < blockCount) {
+                cursor.setPosition(doc->findBlockByNumber(hunk.oldStart).position());
+                cursor.insertText(text + QLatin1Char('\n'));
+            } else {
+                cursor.movePosition(QTextCursor::End);
+                cursor.insertText(QLatin1Char('\n') + text);
+            }
+        }
+    }
+
+    cursor.endEditBlock();
+    verticalScrollBar()->setValue(scrollValue);
+}
+
+void MarkdownEditor::setProblemMarkers(const QVector<ProblemMarker> &markers)
+{
+    problemSelections.clear();
+    int end = document()->characterCount() - 1;
+    for (const ProblemMarker &marker : markers) {
+        if (marker.position < 0 || marker.position + marker.length > end) {
+            continue;
+        }
+
+        QTextEdit::ExtraSelection selection;
+        selection.format.setUnderlineStyle(QTextCharFormat::WaveUnderline);
+        selection.format.setUnderlineColor(QColor(220, 50, 47));
+        selection.format.setToolTip(marker.message);
+        selection.cursor = QTextCursor(document());
+        selection.cursor.setPosition(marker.position);
+        selection.cursor.setPosition(marker.position + marker.length, QTextCursor::KeepAnchor);
+        problemSelections.append(selection);
+    }
+    setExtraSelections(problemSelections);
+}
+
+void MarkdownEditor::setLineChangesShown(bool shown)
+{
+    if (shown == lineChangesShown) {
+        return;
+    }
+    lineChangesShown = shown;
+    if (!shown) {
+        lineChanges.clear();
+    }
+    updateGutterGeometry();
+}
+
+void MarkdownEditor::setLineChanges(const QVector<LineDiff::Hunk> &hunks)
+{
+    lineChanges = hunks;
+    lineChangeOffsets.resize(hunks.size());
+    int offset = 0;
+    for (int i = 0; i < hunks.size(); ++i) {
+        offset += hunks[i].oldCount - hunks[i].newCount;
+        lineChangeOffsets[i] = offset;
+    }
+    gutter->update();
+}
+
+void MarkdownEditor::setBlameShown(bool shown)
+{
+    if (shown == blameShown) {
+        return;
+    }
+    blameShown = shown;
+    if (!shown) {
+        blameLines.clear();
+    }
+    updateGutterGeometry();
+}
+
+void MarkdownEditor::setBlame(const QVector<GitBlame::Line> &lines)
+{
+    blameLines = lines;
+    gutter->update();
+}
+
+int MarkdownEditor::blameWidth() const
+{
+    return blameShown ? fontMetrics().horizontalAdvance(QLatin1Char('0')) * BlameColumnChars + 8 : 0;
+}
+
+int MarkdownEditor::gutterWidth() const
+{
+    return blameWidth() + (lineChangesShown ? ChangeMarkerWidth + 2 : 0);
+}
+
+void MarkdownEditor::updateGutterGeometry()
+{
+    int width = gutterWidth();
+    setViewportMargins(width, 0, 0, 0);
+    QRect rect = contentsRect();
+    gutter->setGeometry(rect.left(), rect.top(), width, rect.height());
+    gutter->setVisible(width > 0);
+}
+
+void MarkdownEditor::resizeEvent(QResizeEvent *event)
+{
+    QPlainTextEdit::resizeEvent(event);
+    updateGutterGeometry();
+}
+
+void MarkdownEditor::updateGutter(const QRect &rect, int dy)
+{
+    if (!gutter->isVisible()) {
+        return;
+    }
+    if (dy) {
+        gutter->scroll(0, dy);
+    } else {
+        gutter->update(0, rect.y(), gutter->width(), rect.height());
+    }
+}
+
+const LineDiff::Hunk *MarkdownEditor::lineChangeAt(int line) const
+{
+    auto it = std::upper_bound(lineChanges.begin(), lineChanges.end(), line,
+                               [](int line, const LineDiff::Hunk &hunk) { return line < hunk.newStart; });
+    if (it == lineChanges.begin()) {
+        return nullptr;
+    }
+    --it;
+    // A deletion has no lines of its own and is marked on the line after it
+    return line < it->newStart + qMax(1, it->newCount) ? &*it : nullptr;
+}
+
+int MarkdownEditor::headLineFor(int line) const
+{
+    auto it = std::upper_bound(lineChanges.begin(), lineChanges.end(), line,
+                               [](int line, const LineDiff::Hunk &hunk) { return line < hunk.newStart; });
+    if (it == lineChanges.begin()) {
+        return line;
+    }
+    --it;
+    if (line < it->newStart + it->newCount) {
+        return -1;
+    }
+    return line + lineChangeOffsets[it - lineChanges.begin()];
+}
+
+const GitBlame::Line *MarkdownEditor::blameFor(int line) const
+{
+    int headLine = headLineFor(line);
+    if (headLine < 0 || headLine >= blameLines.size() || blameLines[headLine].commit.isEmpty()) {
+        return nullptr;
+    }
+    return &blameLines[headLine];
+}
+
+void MarkdownEditor::paintGutter(QPaintEvent *event)
+{
+    QPainter painter(gutter);
+    painter.fillRect(event->rect(), palette().color(QPalette::Base));
+    if (lineChanges.isEmpty() && blameLines.isEmpty()) {
+        return;
+    }
+
+    const QColor added(46, 160, 67);
+    const QColor modified(0, 120, 212);
+    const QColor deleted(248, 81, 73);
+    int markerLeft = blameWidth();
+    painter.setPen(palette().color(QPalette::PlaceholderText));
+
+    QTextBlock block = firstVisibleBlock();
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    QString previousCommit;
+    while (block.isValid() && top <= event->rect().bottom()) {
+        qreal height = blockBoundingRect(block).height();
+        int line = block.blockNumber();
+
+        // Only the first of consecutive lines from one commit is labelled
+        const GitBlame::Line *blame = blameShown ? blameFor(line) : nullptr;
+        if (blame && blame->commit != previousCommit) {
+            QString label = QDateTime::fromSecsSinceEpoch(blame->time).toString("yyyy-MM-dd")
+                + QLatin1Char(' ') + blame->author;
+            QRectF rect(4, top, markerLeft - 8, fontMetrics().height());
+            painter.drawText(rect, Qt::AlignLeft | Qt::AlignVCenter,
+                             fontMetrics().elidedText(label, Qt::ElideRight, markerLeft - 8));
+        }
+        previousCommit = blame ? blame->commit : QString();
+
+        const LineDiff::Hunk *hunk = lineChangesShown ? lineChangeAt(line) : nullptr;
+        if (hunk && hunk->newCount > 0) {
+            QRectF marker(markerLeft, top, ChangeMarkerWidth, height);
+            painter.fillRect(marker, hunk->oldCount > 0 ? modified : added);
+        } else if (hunk) {
+            painter.fillRect(QRectF(markerLeft, top - 1, ChangeMarkerWidth + 2, 3), deleted);
+        }
+
+        // Lines deleted from the end of the file are marked below the last one
+        if (lineChangesShown && !block.next().isValid()) {
+            const LineDiff::Hunk *end = lineChangeAt(line + 1);
+            if (end && end->newCount == 0) {
+                painter.fillRect(QRectF(markerLeft, top + height - 2, ChangeMarkerWidth + 2, 3), deleted);
+            }
+        }
+
+        block = block.next();
+        top += height;
+    }
+}
+
+QString MarkdownEditor::gutterToolTip(const QPoint &position) const
+{
+    if (!blameShown || position.x() >= blameWidth()) {
+        return QString();
+    }
+
+    QTextBlock block = firstVisibleBlock();
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    while (block.isValid() && top <= position.y()) {
+        qreal height = blockBoundingRect(block).height();
+        if (position.y() < top + height) {
+            const GitBlame::Line *blame = blameFor(block.blockNumber());
+            if (!blame) {
+                return QString();
+            }
+            return QString("%1  %2, %3\n%4").arg(
+                blame->commit.left(8), blame->author,
+                QDateTime::fromSecsSinceEpoch(blame->time).toString("yyyy-MM-dd hh:mm"),
+                blame->summary);
+        }
+        block = block.next();
+        top += height;
+    }
+    return QString();
+}
+
+bool MarkdownEditor::event(QEvent *event)
+{
+    if (event->type() == QEvent::ToolTip) {
+        QHelpEvent *helpEvent = static_cast<QHelpEvent *>(event);
+        int position = cursorForPosition(viewport()->mapFromGlobal(helpEvent->globalPos())).position();
+        for (const QTextEdit::ExtraSelection &selection : std::as_const(problemSelections)) {
+            if (selection.cursor.document() == document()
+                    && position >= selection.cursor.selectionStart()
+                    && position <= selection.cursor.selectionEnd()) {
+                QToolTip::showText(helpEvent->globalPos(), selection.format.toolTip(), this);
+                return true;
+            }
+        }
+        QToolTip::hideText();
+        return true;
+    }
+    return QPlainTextEdit::event(event);
+}
+
 void MarkdownEditor::dragEnterEvent(QDragEnterEvent *event)
 {
     // Accept drag if it contains URLs (file paths)
@@ -3,31 +3,99 @@
 
 #include <QPlainTextEdit>
 
+#include "linediff.h"
+#include "gitblame.h"
+
 class MarkdownHighlighter;
+class EditorGutter;
+class QTimer;
 
 class MarkdownEditor : public QPlainTextEdit
 {
     Q_OBJECT
 
 public:
+    struct ProblemMarker
+    {
+        int position = 0;
+        int length = 0;
+        QString message;
+    };
+
     explicit MarkdownEditor(QWidget *parent = nullptr);
     ~MarkdownEditor();
 
     void setCurrentFilePath(const QString &path);
     QString getCurrentFilePath() const;
+    void appendText(const QString &text);
+    // A document set up like the editor's own (layout, font, highlighting), for use with setDocument
+    QTextDocument *createDocument(const QString &text, QObject *parent) const;
+    // The highlighter of the document currently shown, which also tracks its headings
+    MarkdownHighlighter *documentHighlighter() const;
+    // Applies a line diff as one undoable edit, keeping cursor and scroll position
+    void applyLineChanges(const QVector<LineDiff::Hunk> &hunks, const QStringList &newLines);
+    // Underlines the given ranges of the current document, with the message as tooltip
+    void setProblemMarkers(const QVector<ProblemMarker> &markers);
+    // Marks lines added, changed or deleted since the last commit in a strip
+    // left of the text; the strip is only there while shown is true
+    void setLineChangesShown(bool shown);
+    void setLineChanges(const QVector<LineDiff::Hunk> &hunks);
+    // Shows who last changed each line in a column of the strip; the lines
+    // are those of the committed file, matched up through the line changes
+    void setBlameShown(bool shown);
+    void setBlame(const QVector<GitBlame::Line> &lines);
 
 signals:
     void scrollPercentageChanged(double percentage);
 
 protected:
+    bool event(QEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
     void scrollContentsBy(int dx, int dy) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
     void dragMoveEvent(QDragMoveEvent *event) override;
     void dropEvent(QDropEvent *event) override;
 
+private slots:
+    void flushScrollPercentage();
+    void reportScrollCounts();
+    void updateGutter(const QRect &rect, int dy);
+
 private:
-    MarkdownHighlighter *highlighter;
+    friend class EditorGutter;
+
+    int frameInterval() const;
+    int gutterWidth() const;
+    int blameWidth() const;
+    void updateGutterGeometry();
+    void paintGutter(QPaintEvent *event);
+    QString gutterToolTip(const QPoint &position) const;
+    // The hunk covering line in the new text, or a deletion just before it
+    const LineDiff::Hunk *lineChangeAt(int line) const;
+    // The same line in the committed text, or -1 if it was changed since
+    int headLineFor(int line) const;
+    const GitBlame::Line *blameFor(int line) const;
+
     QString currentFilePath;
+
+    // Scroll sync is throttled to one update per display frame, latest value wins
+    QTimer *scrollSyncTimer;
+    double pendingScrollPercentage;
+    bool scrollSyncPending;
+    // Counted here and passed to Diagnostics once per frame, off the scroll path
+    int scrollEvents;
+    int mergedScrollEvents;
+    int deliveredScrollUpdates;
+
+    // Their cursors move along with edits until the next check replaces them
+    QList<QTextEdit::ExtraSelection> problemSelections;
+
+    EditorGutter *gutter;
+    bool lineChangesShown;
+    QVector<LineDiff::Hunk> lineChanges;  // sorted by newStart
+    QVector<int> lineChangeOffsets;       // committed minus current line number after each hunk
+    bool blameShown;
+    QVector<GitBlame::Line> blameLines;
     
     void insertImageMarkdown(const QString &imagePath, const QPoint &dropPos);
     QString calculateRelativePath(const QString &fromFile, const QString &toFile) const;
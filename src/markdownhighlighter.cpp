@@ -1,7 +1,55 @@
 #include "markdownhighlighter.h"
+#include "markdownlinks.h"
+
+#include <QPointer>
+#include <algorithm>
+
+namespace {
+
+// Inside a fenced code block the block state records its opener, twice its
+// length plus one for tildes, so only a matching fence closes it; 0 is outside
+int stateForFence(const QString &fence)
+{
+    return fence.size() * 2 + (fence[0] == QLatin1Char('~') ? 1 : 0);
+}
+
+QString fenceForState(int state)
+{
+    if (state <= 0) {
+        return QString();
+    }
+    return QString(state / 2, state % 2 ? QLatin1Char('~') : QLatin1Char('`'));
+}
+
+} // namespace
+
+// Attached to heading blocks; the document deletes it along with the block
+class MarkdownHighlighter::HeadingData : public QTextBlockUserData
+{
+public:
+    HeadingData(MarkdownHighlighter *highlighter, const QTextBlock &block, int level, const QString &title)
+        : highlighter(highlighter), block(block), level(level), title(title)
+    {
+    }
+
+    ~HeadingData() override
+    {
+        // The highlighter goes first when the whole document is destroyed
+        if (highlighter) {
+            highlighter->headingRemoved(this);
+        }
+    }
+
+    QPointer<MarkdownHighlighter> highlighter;
+    QTextBlock block;
+    int level;
+    QString title;
+};
 
 MarkdownHighlighter::MarkdownHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent)
+    , headingPattern("^ {0,3}(#{1,6})\\s+(.*?)(?:\\s+#+)?\\s*$")
+    , headingsSorted(true)
 {
     HighlightingRule rule;
 
@@ -117,33 +165,87 @@ void MarkdownHighlighter::highlightBlock(const QString &text)
         }
     }
 
-    // Handle code blocks (multiline)
-    setCurrentBlockState(0);
+    // Handle code blocks (multiline), the same way MarkdownLinks finds them
+    QString opener = fenceForState(previousBlockState());
+    if (!opener.isEmpty()) {
+        setFormat(0, text.length(), codeBlockFormat);
+        setCurrentBlockState(MarkdownLinks::closesFence(text, opener) ? 0 : previousBlockState());
+    } else {
+        QString fence = MarkdownLinks::fenceOf(text);
+        if (!fence.isEmpty()) {
+            setFormat(0, text.length(), codeBlockFormat);
+        }
+        setCurrentBlockState(fence.isEmpty() ? 0 : stateForFence(fence));
+    }
 
-    int startIndex = 0;
-    if (previousBlockState() != 1) {
-        QRegularExpression startExpression("^```");
-        QRegularExpressionMatch match = startExpression.match(text);
-        startIndex = match.hasMatch() ? match.capturedStart() : -1;
+    updateHeading(text);
+}
+
+void MarkdownHighlighter::updateHeading(const QString &text)
+{
+    int level = 0;
+    QString title;
+    if (previousBlockState() <= 0 && text.contains(QLatin1Char('#'))) {
+        QRegularExpressionMatch match = headingPattern.match(text);
+        if (match.hasMatch()) {
+            level = match.capturedLength(1);
+            title = match.captured(2);
+        }
     }
 
-    while (startIndex >= 0) {
-        QRegularExpression endExpression("^```");
-        QRegularExpressionMatch match = endExpression.match(text, startIndex + 3);
-        int endIndex = match.capturedStart();
-        int blockLength;
-
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            blockLength = text.length() - startIndex;
-        } else {
-            blockLength = endIndex - startIndex + match.capturedLength();
+    HeadingData *data = static_cast<HeadingData *>(currentBlockUserData());
+    if (level == 0) {
+        if (data) {
+            // Deleting the data unregisters it
+            setCurrentBlockUserData(nullptr);
         }
+        return;
+    }
 
-        setFormat(startIndex, blockLength, codeBlockFormat);
+    if (data) {
+        data->block = currentBlock();
+    }
 
-        QRegularExpression nextStartExpression("^```");
-        match = nextStartExpression.match(text, startIndex + blockLength);
-        startIndex = match.hasMatch() ? match.capturedStart() : -1;
+    if (!data) {
+        data = new HeadingData(this, currentBlock(), level, title);
+        setCurrentBlockUserData(data);
+        headingBlocks.insert(data);
+        headingsSorted = false;
+        emit headingsChanged();
+    } else if (data->level != level || data->title != title) {
+        data->level = level;
+        data->title = title;
+        headingsSorted = false;
+        emit headingsChanged();
+    }
+}
+
+void MarkdownHighlighter::headingRemoved(HeadingData *data)
+{
+    if (headingBlocks.remove(data)) {
+        headingsSorted = false;
+        emit headingsChanged();
+    }
+}
+
+QVector<MarkdownHighlighter::Heading> MarkdownHighlighter::headings() const
+{
+    // Blocks keep their relative order while text moves around them, so the
+    // sort is only redone when a heading comes, goes or changes
+    if (!headingsSorted) {
+        sortedHeadings.clear();
+        sortedHeadings.reserve(headingBlocks.size());
+        for (HeadingData *data : headingBlocks) {
+            Heading heading;
+            heading.block = data->block;
+            heading.level = data->level;
+            heading.title = data->title;
+            sortedHeadings.append(heading);
+        }
+        std::sort(sortedHeadings.begin(), sortedHeadings.end(), [](const Heading &a, const Heading &b) {
+            return a.block.position() < b.block.position();
+        });
+        headingsSorted = true;
     }
+    return sortedHeadings;
 }
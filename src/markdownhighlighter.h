@@ -4,18 +4,40 @@
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
 #include <QRegularExpression>
+#include <QSet>
+#include <QTextBlock>
+#include <QVector>
 
 class MarkdownHighlighter : public QSyntaxHighlighter
 {
     Q_OBJECT
 
 public:
+    struct Heading
+    {
+        QTextBlock block;
+        int level = 0;
+        QString title;
+    };
+
     explicit MarkdownHighlighter(QTextDocument *parent = nullptr);
 
+    // Headings outside code blocks, in document order. Heading blocks are
+    // tagged as they are highlighted, so an edit only costs the blocks it touches.
+    QVector<Heading> headings() const;
+
+signals:
+    void headingsChanged();
+
 protected:
     void highlightBlock(const QString &text) override;
 
 private:
+    class HeadingData;
+
+    void updateHeading(const QString &text);
+    void headingRemoved(HeadingData *data);
+
     struct HighlightingRule
     {
         QRegularExpression pattern;
@@ -37,6 +59,11 @@ private:
     QTextCharFormat tableFormat;
     QTextCharFormat horizontalRuleFormat;
     QTextCharFormat codeBlockFormat;
+
+    QRegularExpression headingPattern;
+    QSet<HeadingData *> headingBlocks;
+    mutable QVector<Heading> sortedHeadings;
+    mutable bool headingsSorted;
 };
 
 #endif // MARKDOWNHIGHLIGHTER_H
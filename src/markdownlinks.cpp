@@ -0,0 +1,240 @@
+#include "markdownlinks.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QRegularExpression>
+#include <QUrl>
+#include <algorithm>
+
+namespace {
+
+// Code spans blanked out, so positions still line up with the original
+QString maskCodeSpans(const QString &line)
+{
+    QString masked = line;
+    int start = -1;
+    for (int i = 0; i < masked.size(); ++i) {
+        if (masked[i] != QLatin1Char('`')) {
+            continue;
+        }
+        if (start < 0) {
+            start = i;
+        } else {
+            for (int j = start; j <= i; ++j) {
+                masked[j] = QLatin1Char(' ');
+            }
+            start = -1;
+        }
+    }
+    return masked;
+}
+
+// Index of the '[' matching the ']' at close, or -1
+int openingBracket(const QString &line, int close)
+{
+    int depth = 0;
+    for (int i = close; i >= 0; --i) {
+        if (i > 0 && line[i - 1] == QLatin1Char('\\')) {
+            continue;
+        }
+        if (line[i] == QLatin1Char(']')) {
+            depth++;
+        } else if (line[i] == QLatin1Char('[') && --depth == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Calls handle(lineStart, line) for every line outside fenced code blocks
+template <typename Handler>
+void forEachProseLine(const QString &text, Handler handle)
+{
+    QString fence;  // the opener while inside a fenced block
+    int lineStart = 0;
+    while (lineStart <= text.size()) {
+        int lineEnd = text.indexOf(QLatin1Char('\n'), lineStart);
+        if (lineEnd < 0) {
+            lineEnd = text.size();
+        }
+        QString line = text.mid(lineStart, lineEnd - lineStart);
+
+        if (!fence.isEmpty()) {
+            if (MarkdownLinks::closesFence(line, fence)) {
+                fence.clear();
+            }
+        } else {
+            fence = MarkdownLinks::fenceOf(line);
+            if (fence.isEmpty()) {
+                handle(lineStart, line);
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+}
+
+} // namespace
+
+QVector<MarkdownLinks::Link> MarkdownLinks::extractLinks(const QString &text)
+{
+    // The tail of an inline link, "](target "title")"; the text part is found by
+    // walking back to the matching bracket, so links around images work too
+    QRegularExpression inlineTail("\\]\\(\\s*(<[^>]*>|[^)\\s]+)(?:\\s+(?:\"[^\"]*\"|'[^']*'))?\\s*\\)");
+    QRegularExpression definition("^ {0,3}\\[[^\\]]+\\]:\\s*(<[^>]*>|\\S+)");
+
+    QVector<Link> links;
+    forEachProseLine(text, [&](int lineStart, const QString &rawLine) {
+        if (!rawLine.contains(QLatin1Char(']'))) {
+            return;
+        }
+        QString line = maskCodeSpans(rawLine);
+
+        auto addLink = [&](const QRegularExpressionMatch &match, bool image) {
+            int start = match.capturedStart(1);
+            int length = match.capturedLength(1);
+            QString target = match.captured(1);
+            if (target.startsWith(QLatin1Char('<')) && target.endsWith(QLatin1Char('>'))) {
+                target = target.mid(1, target.size() - 2);
+                start++;
+                length -= 2;
+            }
+
+            Link link;
+            link.position = lineStart + start;
+            link.length = length;
+            link.target = target;
+            link.image = image;
+            links.append(link);
+        };
+
+        QRegularExpressionMatch definitionMatch = definition.match(line);
+        if (definitionMatch.hasMatch()) {
+            addLink(definitionMatch, false);
+            return;
+        }
+
+        QRegularExpressionMatchIterator it = inlineTail.globalMatch(line);
+        while (it.hasNext()) {
+            QRegularExpressionMatch match = it.next();
+            int open = openingBracket(line, match.capturedStart(0));
+            if (open < 0) {
+                continue;
+            }
+            addLink(match, open > 0 && line[open - 1] == QLatin1Char('!'));
+        }
+    });
+    return links;
+}
+
+QStringList MarkdownLinks::headingAnchors(const QString &text)
+{
+    QStringList anchors;
+    QHash<QString, int> seen;
+
+    forEachProseLine(text, [&](int, const QString &line) {
+        int position = 0;
+        while (position < line.size() && position < 3 && line[position] == QLatin1Char(' ')) {
+            position++;
+        }
+        int level = 0;
+        while (position + level < line.size() && line[position + level] == QLatin1Char('#')) {
+            level++;
+        }
+        if (level == 0 || level > 6) {
+            return;
+        }
+
+        QString heading = line.mid(position + level);
+        if (!heading.isEmpty() && !heading[0].isSpace()) {
+            return;
+        }
+
+        // Closing hashes are not part of the heading
+        heading = heading.trimmed();
+        int end = heading.size();
+        while (end > 0 && heading[end - 1] == QLatin1Char('#')) {
+            end--;
+        }
+        if (end < heading.size() && (end == 0 || heading[end - 1].isSpace())) {
+            heading.truncate(end);
+        }
+
+        // Repeated headings get -1, -2, ... like on GitHub
+        QString anchor = anchorForHeading(heading.trimmed());
+        int count = seen.value(anchor, 0);
+        seen.insert(anchor, count + 1);
+        anchors.append(count == 0 ? anchor : anchor + QLatin1Char('-') + QString::number(count));
+    });
+    return anchors;
+}
+
+QString MarkdownLinks::anchorForHeading(const QString &heading)
+{
+    QString anchor;
+    anchor.reserve(heading.size());
+    for (QChar c : heading.toLower()) {
+        if (c.isLetterOrNumber() || c == QLatin1Char('-') || c == QLatin1Char('_')) {
+            anchor += c;
+        } else if (c == QLatin1Char(' ')) {
+            anchor += QLatin1Char('-');
+        }
+    }
+    return anchor;
+}
+
+bool MarkdownLinks::resolveTarget(const QString &fromFile, const QString &target,
+                                  QString *filePath, QString *fragment)
+{
+    // URLs and other schemes; a single letter before ':' would be a drive
+    QRegularExpression scheme("^[a-zA-Z][a-zA-Z0-9+.-]+:");
+    if (target.isEmpty() || target.startsWith(QLatin1String("//")) || scheme.match(target).hasMatch()) {
+        return false;
+    }
+
+    QString path = target;
+    int hash = path.indexOf(QLatin1Char('#'));
+    *fragment = hash >= 0 ? QUrl::fromPercentEncoding(path.mid(hash + 1).toUtf8()) : QString();
+    if (hash >= 0) {
+        path.truncate(hash);
+    }
+    int query = path.indexOf(QLatin1Char('?'));
+    if (query >= 0) {
+        path.truncate(query);
+    }
+    path = QUrl::fromPercentEncoding(path.toUtf8());
+
+    if (path.isEmpty()) {
+        filePath->clear();
+        return true;
+    }
+
+    // Site-root paths depend on how the docs are published, and an untitled
+    // document has no directory to resolve against
+    if (path.startsWith(QLatin1Char('/')) || fromFile.isEmpty()) {
+        return false;
+    }
+
+    *filePath = QDir::cleanPath(QFileInfo(fromFile).absolutePath() + QLatin1Char('/') + path);
+    return true;
+}
+
+QString MarkdownLinks::fenceOf(const QString &line)
+{
+    QString trimmed = line.trimmed();
+    if (!trimmed.startsWith(QLatin1String("```")) && !trimmed.startsWith(QLatin1String("~~~"))) {
+        return QString();
+    }
+    int length = 3;
+    while (length < trimmed.size() && trimmed[length] == trimmed[0]) {
+        ++length;
+    }
+    return trimmed.left(length);
+}
+
+bool MarkdownLinks::closesFence(const QString &line, const QString &fence)
+{
+    QString trimmed = line.trimmed();
+    return trimmed.size() >= fence.size()
+        && std::all_of(trimmed.cbegin(), trimmed.cend(), [&fence](QChar c) { return c == fence[0]; });
+}
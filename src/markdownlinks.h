@@ -0,0 +1,44 @@
+#ifndef MARKDOWNLINKS_H
+#define MARKDOWNLINKS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Finds links and heading anchors in markdown source. Used by the workspace
+// index and by the editor's broken-link check, so both agree on what a
+// link is.
+class MarkdownLinks
+{
+public:
+    struct Link
+    {
+        int position = 0;  // of the target within the text
+        int length = 0;
+        QString target;    // as written
+        bool image = false;
+    };
+
+    // Inline links and images, e.g. [text](../other.md#anchor), and reference
+    // definitions; code blocks and code spans are skipped
+    static QVector<Link> extractLinks(const QString &text);
+
+    // GitHub-style anchors of the ATX headings, in document order
+    static QStringList headingAnchors(const QString &text);
+    static QString anchorForHeading(const QString &heading);
+
+    // Splits a link target into the absolute path it refers to (empty for the
+    // document itself) and its fragment. Returns false for URLs and for
+    // targets that cannot be resolved, which are not checked.
+    static bool resolveTarget(const QString &fromFile, const QString &target,
+                              QString *filePath, QString *fragment);
+
+    // The run of ``` or ~~~ opening a fenced code block, e.g. "````" for
+    // "````cpp"; empty if the line is no fence
+    static QString fenceOf(const QString &line);
+    // Whether line closes the block opened by fence: only the same character,
+    // at least as many times and with nothing after it
+    static bool closesFence(const QString &line, const QString &fence);
+};
+
+#endif // MARKDOWNLINKS_H
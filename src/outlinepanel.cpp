@@ -0,0 +1,130 @@
+#include "outlinepanel.h"
+#include "markdownhighlighter.h"
+
+#include <QLineEdit>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+OutlinePanel::OutlinePanel(QWidget *parent)
+    : QWidget(parent)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 5, 0, 0);
+    layout->setSpacing(5);
+
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText(tr("Filter headings"));
+    filterEdit->setClearButtonEnabled(true);
+    connect(filterEdit, &QLineEdit::textChanged, this, &OutlinePanel::refresh);
+    connect(filterEdit, &QLineEdit::returnPressed, this, [this]() {
+        if (headingTree->topLevelItemCount() > 0) {
+            onItemActivated(headingTree->topLevelItem(0));
+        }
+    });
+    layout->addWidget(filterEdit);
+
+    headingTree = new QTreeWidget(this);
+    headingTree->setHeaderHidden(true);
+    headingTree->setUniformRowHeights(true);
+    connect(headingTree, &QTreeWidget::itemClicked, this, &OutlinePanel::onItemActivated);
+    connect(headingTree, &QTreeWidget::itemActivated, this, &OutlinePanel::onItemActivated);
+    layout->addWidget(headingTree);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(150);
+    connect(refreshTimer, &QTimer::timeout, this, &OutlinePanel::refresh);
+}
+
+void OutlinePanel::setHighlighter(MarkdownHighlighter *newHighlighter)
+{
+    if (newHighlighter == highlighter) {
+        return;
+    }
+    if (highlighter) {
+        disconnect(highlighter, nullptr, this, nullptr);
+    }
+    highlighter = newHighlighter;
+    if (highlighter) {
+        connect(highlighter, &MarkdownHighlighter::headingsChanged, refreshTimer, [this]() {
+            refreshTimer->start();
+        });
+        // The blocks go with the document
+        connect(highlighter, &QObject::destroyed, this, [this]() {
+            headingTree->clear();
+            headingBlocks.clear();
+        });
+    }
+    refresh();
+}
+
+void OutlinePanel::focusFilter()
+{
+    filterEdit->setFocus();
+    filterEdit->selectAll();
+}
+
+void OutlinePanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refresh();
+}
+
+void OutlinePanel::refresh()
+{
+    // Hidden panels catch up when shown
+    refreshTimer->stop();
+    if (!isVisible()) {
+        return;
+    }
+
+    headingTree->clear();
+    headingBlocks.clear();
+    if (!highlighter) {
+        return;
+    }
+
+    const QVector<MarkdownHighlighter::Heading> headings = highlighter->headings();
+    QString filter = filterEdit->text().trimmed();
+
+    if (!filter.isEmpty()) {
+        // A flat list of matches, so none hides under a collapsed parent
+        for (const MarkdownHighlighter::Heading &heading : headings) {
+            if (heading.title.contains(filter, Qt::CaseInsensitive)) {
+                QTreeWidgetItem *item = new QTreeWidgetItem(headingTree, QStringList(heading.title));
+                item->setData(0, Qt::UserRole, headingBlocks.size());
+                headingBlocks.append(heading.block);
+            }
+        }
+        return;
+    }
+
+    // Each heading goes under the nearest earlier heading of a higher level
+    QVector<QTreeWidgetItem *> parents(7, nullptr);
+    for (const MarkdownHighlighter::Heading &heading : headings) {
+        QTreeWidgetItem *parent = nullptr;
+        for (int level = heading.level - 1; level >= 1 && !parent; --level) {
+            parent = parents[level];
+        }
+
+        QTreeWidgetItem *item = parent ? new QTreeWidgetItem(parent, QStringList(heading.title))
+                                       : new QTreeWidgetItem(headingTree, QStringList(heading.title));
+        item->setData(0, Qt::UserRole, headingBlocks.size());
+        headingBlocks.append(heading.block);
+
+        parents[heading.level] = item;
+        for (int level = heading.level + 1; level < parents.size(); ++level) {
+            parents[level] = nullptr;
+        }
+    }
+    headingTree->expandAll();
+}
+
+void OutlinePanel::onItemActivated(QTreeWidgetItem *item)
+{
+    int index = item->data(0, Qt::UserRole).toInt();
+    if (index >= 0 && index < headingBlocks.size() && headingBlocks[index].isValid()) {
+        emit headingActivated(headingBlocks[index].position());
+    }
+}
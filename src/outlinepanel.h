@@ -0,0 +1,46 @@
+#ifndef OUTLINEPANEL_H
+#define OUTLINEPANEL_H
+
+#include <QPointer>
+#include <QTextBlock>
+#include <QVector>
+#include <QWidget>
+
+class QLineEdit;
+class QTimer;
+class QTreeWidget;
+class QTreeWidgetItem;
+class MarkdownHighlighter;
+
+// Headings of the current document as a tree, with a filter box. The list
+// comes from the document's highlighter, which keeps it current as blocks
+// change; the tree is rebuilt shortly after the headings change.
+class OutlinePanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit OutlinePanel(QWidget *parent = nullptr);
+
+    void setHighlighter(MarkdownHighlighter *highlighter);
+    void focusFilter();
+
+signals:
+    void headingActivated(int position);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void refresh();
+    void onItemActivated(QTreeWidgetItem *item);
+
+private:
+    QPointer<MarkdownHighlighter> highlighter;
+    QLineEdit *filterEdit;
+    QTreeWidget *headingTree;
+    QVector<QTextBlock> headingBlocks;  // per item, so jumps follow later edits
+    QTimer *refreshTimer;  // Collects the changes of one edit or load into one rebuild
+};
+
+#endif // OUTLINEPANEL_H
@@ -0,0 +1,294 @@
+#include "pathindex.h"
+#include "diagnostics.h"
+#include "ignorerules.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// Bonuses for one matched query character
+const int MatchBonus = 1;
+const int ConsecutiveBonus = 4;
+const int WordStartBonus = 6;
+// Whole query found within the file name
+const int FileNameBonus = 50;
+
+bool isWordStart(const QString &path, int position)
+{
+    if (position == 0) {
+        return true;
+    }
+    QChar previous = path[position - 1];
+    QChar current = path[position];
+    if (previous == QLatin1Char('/') || previous == QLatin1Char('-') || previous == QLatin1Char('_')
+            || previous == QLatin1Char('.') || previous == QLatin1Char(' ')) {
+        return true;
+    }
+    // camelCase
+    return current.isUpper() && previous.isLower();
+}
+
+} // namespace
+
+struct PathIndex::BuildJob
+{
+    QString rootPath;
+    QStringList nameFilters;
+    QStringList ignorePatterns;
+    std::atomic<bool> cancelled{false};
+};
+
+PathIndex::PathIndex(const QStringList &nameFilters, QObject *parent)
+    : QObject(parent)
+    , nameFilters(nameFilters)
+{
+    pool.setMaxThreadCount(1);
+}
+
+PathIndex::~PathIndex()
+{
+    if (buildJob) {
+        buildJob->cancelled = true;
+    }
+    pool.clear();
+    pool.waitForDone();
+}
+
+void PathIndex::setRootPath(const QString &path)
+{
+    QString absolutePath = QDir(path).absolutePath();
+    if (absolutePath != root) {
+        // Paths of another folder are no use meanwhile
+        root = absolutePath;
+        entries.clear();
+        lastQuery.clear();
+        lastMatches.clear();
+    }
+
+    if (buildJob) {
+        buildJob->cancelled = true;
+    }
+    auto job = std::make_shared<BuildJob>();
+    job->rootPath = root;
+    job->nameFilters = nameFilters;
+    job->ignorePatterns = ignorePatterns;
+    buildJob = job;
+
+    pool.start([this, job]() { build(job); });
+}
+
+QString PathIndex::rootPath() const
+{
+    return root;
+}
+
+void PathIndex::setIgnorePatterns(const QStringList &patterns)
+{
+    // Used from the next build on
+    ignorePatterns = patterns;
+}
+
+bool PathIndex::isBuilding() const
+{
+    return buildJob != nullptr;
+}
+
+int PathIndex::pathCount() const
+{
+    return entries.size();
+}
+
+void PathIndex::build(std::shared_ptr<BuildJob> job)
+{
+    // Runs on the pool thread
+    if (job->cancelled) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    IgnoreRules ignoreRules;
+    ignoreRules.setRootPath(job->rootPath);
+    ignoreRules.setExtraPatterns(job->ignorePatterns);
+
+    QDir rootDir(job->rootPath);
+    QVector<Entry> paths;
+    bool complete = ignoreRules.forEachFile(job->nameFilters, [&](const QFileInfo &fileInfo) {
+        if (job->cancelled) {
+            return false;
+        }
+
+        Entry entry;
+        entry.relativePath = rootDir.relativeFilePath(fileInfo.filePath());
+        // Lowercased per character, so positions line up with relativePath
+        entry.lowerPath = entry.relativePath;
+        for (QChar &c : entry.lowerPath) {
+            c = c.toLower();
+        }
+        entry.nameStart = entry.relativePath.lastIndexOf(QLatin1Char('/')) + 1;
+        entry.mask = characterMask(entry.lowerPath);
+        paths.append(entry);
+        return true;
+    });
+    if (!complete) {
+        return;
+    }
+
+    std::sort(paths.begin(), paths.end(), [](const Entry &a, const Entry &b) {
+        return a.relativePath < b.relativePath;
+    });
+    Diagnostics::recordDuration("Quick open path scan", timer.nsecsElapsed() / 1000);
+
+    QMetaObject::invokeMethod(this, [this, job, paths]() {
+        onBuilt(job, paths);
+    }, Qt::QueuedConnection);
+}
+
+void PathIndex::onBuilt(std::shared_ptr<BuildJob> job, const QVector<Entry> &paths)
+{
+    if (job != buildJob) {
+        return;
+    }
+    buildJob.reset();
+
+    entries = paths;
+    lastQuery.clear();
+    lastMatches.clear();
+    emit built(entries.size());
+}
+
+QVector<PathIndex::Match> PathIndex::match(const QString &query, int maxResults)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Spaces only separate what the user remembers of the path
+    QString lowerQuery = query.toLower();
+    lowerQuery.remove(QLatin1Char(' '));
+
+    QVector<QPair<int, int>> scored;  // score, entry
+    if (lowerQuery.isEmpty()) {
+        for (int i = 0; i < entries.size() && i < maxResults; ++i) {
+            scored.append(qMakePair(0, i));
+        }
+        lastQuery.clear();
+        lastMatches.clear();
+    } else {
+        quint64 queryMask = characterMask(lowerQuery);
+        auto consider = [this, &scored, &lowerQuery, queryMask](int index) {
+            const Entry &entry = entries[index];
+            if ((entry.mask & queryMask) != queryMask) {
+                return;
+            }
+            int value = score(entry, lowerQuery);
+            if (value >= 0) {
+                scored.append(qMakePair(value, index));
+            }
+        };
+
+        // A longer query can only match a subset of what the shorter one did
+        if (!lastQuery.isEmpty() && lowerQuery.startsWith(lastQuery)) {
+            for (int index : std::as_const(lastMatches)) {
+                consider(index);
+            }
+        } else {
+            for (int index = 0; index < entries.size(); ++index) {
+                consider(index);
+            }
+        }
+
+        lastQuery = lowerQuery;
+        lastMatches.clear();
+        lastMatches.reserve(scored.size());
+        for (const QPair<int, int> &candidate : std::as_const(scored)) {
+            lastMatches.append(candidate.second);
+        }
+    }
+
+    // Highest score first, then the shorter path
+    auto better = [this](const QPair<int, int> &a, const QPair<int, int> &b) {
+        if (a.first != b.first) {
+            return a.first > b.first;
+        }
+        int lengthA = entries[a.second].relativePath.size();
+        int lengthB = entries[b.second].relativePath.size();
+        if (lengthA != lengthB) {
+            return lengthA < lengthB;
+        }
+        return a.second < b.second;
+    };
+    int count = qMin(maxResults, int(scored.size()));
+    std::partial_sort(scored.begin(), scored.begin() + count, scored.end(), better);
+
+    QDir rootDir(root);
+    QVector<Match> matches;
+    matches.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const Entry &entry = entries[scored[i].second];
+        Match match;
+        match.relativePath = entry.relativePath;
+        match.filePath = rootDir.filePath(entry.relativePath);
+        match.score = scored[i].first;
+        matches.append(match);
+    }
+
+    Diagnostics::recordDuration("Quick open match", timer.nsecsElapsed() / 1000);
+    return matches;
+}
+
+quint64 PathIndex::characterMask(const QString &lowerText)
+{
+    // One bit per letter and digit; anything else is left to the full comparison
+    quint64 mask = 0;
+    for (QChar c : lowerText) {
+        char16_t unit = c.unicode();
+        if (unit >= u'a' && unit <= u'z') {
+            mask |= quint64(1) << (unit - u'a');
+        } else if (unit >= u'0' && unit <= u'9') {
+            mask |= quint64(1) << (26 + unit - u'0');
+        }
+    }
+    return mask;
+}
+
+int PathIndex::score(const Entry &entry, const QString &query)
+{
+    // What people type is usually part of the file name
+    int nameScore = scoreFrom(entry, entry.nameStart, query);
+    if (nameScore >= 0) {
+        return nameScore + FileNameBonus;
+    }
+    return scoreFrom(entry, 0, query);
+}
+
+int PathIndex::scoreFrom(const Entry &entry, int start, const QString &query)
+{
+    // Greedy subsequence match; -1 if some query character is missing
+    const QChar *path = entry.lowerPath.constData();
+    int length = entry.lowerPath.size();
+    int queryPosition = 0;
+    int previous = -2;
+    int score = 0;
+
+    for (int i = start; i < length && queryPosition < query.size(); ++i) {
+        if (path[i] != query[queryPosition]) {
+            continue;
+        }
+        score += MatchBonus;
+        if (i == previous + 1) {
+            score += ConsecutiveBonus;
+        }
+        if (isWordStart(entry.relativePath, i)) {
+            score += WordStartBonus;
+        }
+        previous = i;
+        queryPosition++;
+    }
+
+    return queryPosition == query.size() ? score : -1;
+}
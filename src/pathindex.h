@@ -0,0 +1,79 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+
+// List of the file paths under a folder, built on a worker thread, with a
+// fuzzy matcher for quick open. Each path carries a bitmask of the letters
+// and digits it contains, so most paths are rejected with a single AND
+// before any characters are compared.
+class PathIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Match
+    {
+        QString filePath;
+        QString relativePath;
+        int score = 0;
+    };
+
+    explicit PathIndex(const QStringList &nameFilters, QObject *parent = nullptr);
+    ~PathIndex();
+
+    // Lists the files under path again; the current list stays searchable
+    // until the new one is ready, unless the folder changed
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+
+    // Ignored folders such as node_modules are not listed; .gitignore files
+    // are followed, plus these patterns in the same syntax
+    void setIgnorePatterns(const QStringList &patterns);
+
+    bool isBuilding() const;
+    int pathCount() const;
+
+    // Best matches first. Typing on from the previous query only rescans
+    // the previous matches.
+    QVector<Match> match(const QString &query, int maxResults = 50);
+
+signals:
+    void built(int pathCount);
+
+private:
+    struct Entry
+    {
+        QString relativePath;
+        QString lowerPath;
+        int nameStart = 0;  // after the last '/'
+        quint64 mask = 0;
+    };
+
+    struct BuildJob;
+
+    void build(std::shared_ptr<BuildJob> job);
+    void onBuilt(std::shared_ptr<BuildJob> job, const QVector<Entry> &paths);
+
+    static quint64 characterMask(const QString &lowerText);
+    static int score(const Entry &entry, const QString &query);
+    static int scoreFrom(const Entry &entry, int start, const QString &query);
+
+    QStringList nameFilters;
+    QStringList ignorePatterns;
+    QString root;
+    QVector<Entry> entries;  // sorted by path
+    std::shared_ptr<BuildJob> buildJob;
+    QThreadPool pool;
+
+    // Matches of the last query, narrowed as it grows
+    QString lastQuery;
+    QVector<int> lastMatches;
+};
+
+#endif // PATHINDEX_H
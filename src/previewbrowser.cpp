@@ -0,0 +1,131 @@
+#include "previewbrowser.h"
+#include "imagecache.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QResizeEvent>
+#include <QTextDocument>
+#include <QTimer>
+
+PreviewBrowser::PreviewBrowser(QWidget *parent)
+    : QTextBrowser(parent)
+    , relayoutNeeded(false)
+    , lastImageWidth(0)
+{
+    imageCache = new ImageCache(this);
+    connect(imageCache, &ImageCache::imageReady, this, &PreviewBrowser::onImageReady);
+
+    // Decoded images arrive one by one; batch them into a single repaint/relayout
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(50);
+    connect(refreshTimer, &QTimer::timeout, this, &PreviewBrowser::refreshImages);
+}
+
+PreviewBrowser::~PreviewBrowser()
+{
+}
+
+void PreviewBrowser::setBaseDirectory(const QString &path)
+{
+    baseDirectory = path;
+}
+
+QVariant PreviewBrowser::loadResource(int type, const QUrl &name)
+{
+    if (type != QTextDocument::ImageResource) {
+        return QTextBrowser::loadResource(type, name);
+    }
+
+    QString filePath = resolveImagePath(name);
+    if (filePath.isEmpty()) {
+        return QTextBrowser::loadResource(type, name);
+    }
+
+    int width = imageWidth();
+    lastImageWidth = width;
+
+    bool ready = false;
+    QImage image = imageCache->image(filePath, width, &ready);
+    if (!ready) {
+        pendingImages[filePath].insert(name);
+        placeholderSizes.insert(name, image.size());
+    }
+
+    return image;
+}
+
+void PreviewBrowser::resizeEvent(QResizeEvent *event)
+{
+    QTextBrowser::resizeEvent(event);
+
+    // Images are decoded for a width bucket; only re-request them when the bucket changes
+    if (lastImageWidth != 0 && imageWidth() != lastImageWidth) {
+        lastImageWidth = imageWidth();
+        emit imageWidthChanged();
+    }
+}
+
+void PreviewBrowser::onImageReady(const QString &filePath)
+{
+    auto it = pendingImages.find(filePath);
+    if (it == pendingImages.end()) {
+        return;
+    }
+
+    const QSet<QUrl> urls = it.value();
+    pendingImages.erase(it);
+
+    int width = imageWidth();
+    for (const QUrl &url : urls) {
+        bool ready = false;
+        QImage image = imageCache->image(filePath, width, &ready);
+        if (!ready) {
+            // Width changed while decoding; a new decode has been queued
+            pendingImages[filePath].insert(url);
+            continue;
+        }
+
+        if (placeholderSizes.take(url) != image.size()) {
+            relayoutNeeded = true;
+        }
+        document()->addResource(QTextDocument::ImageResource, url, image);
+    }
+
+    refreshTimer->start();
+}
+
+void PreviewBrowser::refreshImages()
+{
+    if (relayoutNeeded) {
+        relayoutNeeded = false;
+        document()->markContentsDirty(0, document()->characterCount());
+    } else {
+        viewport()->update();
+    }
+}
+
+QString PreviewBrowser::resolveImagePath(const QUrl &url) const
+{
+    QString path;
+    if (url.isLocalFile()) {
+        path = url.toLocalFile();
+    } else if (url.scheme().isEmpty()) {
+        path = url.path();
+        if (QDir::isRelativePath(path) && !baseDirectory.isEmpty()) {
+            path = QDir(baseDirectory).filePath(path);
+        }
+    } else {
+        return QString();
+    }
+
+    return QFileInfo(path).isFile() ? path : QString();
+}
+
+int PreviewBrowser::imageWidth() const
+{
+    // Leave room for the document margin and body padding, rounded down to 64px buckets
+    int width = viewport()->width() - 2 * int(document()->documentMargin()) - 32;
+    return qMax(64, (width / 64) * 64);
+}
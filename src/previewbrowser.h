@@ -0,0 +1,48 @@
+#ifndef PREVIEWBROWSER_H
+#define PREVIEWBROWSER_H
+
+#include <QTextBrowser>
+#include <QHash>
+#include <QSet>
+#include <QSize>
+#include <QUrl>
+
+class ImageCache;
+class QTimer;
+
+class PreviewBrowser : public QTextBrowser
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewBrowser(QWidget *parent = nullptr);
+    ~PreviewBrowser();
+
+    void setBaseDirectory(const QString &path);
+
+    QVariant loadResource(int type, const QUrl &name) override;
+
+signals:
+    void imageWidthChanged();
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void onImageReady(const QString &filePath);
+    void refreshImages();
+
+private:
+    QString resolveImagePath(const QUrl &url) const;
+    int imageWidth() const;
+
+    ImageCache *imageCache;
+    QString baseDirectory;
+    QHash<QString, QSet<QUrl>> pendingImages;  // file path -> urls showing a placeholder
+    QHash<QUrl, QSize> placeholderSizes;
+    QTimer *refreshTimer;
+    bool relayoutNeeded;
+    int lastImageWidth;
+};
+
+#endif // PREVIEWBROWSER_H
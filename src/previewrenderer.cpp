@@ -0,0 +1,109 @@
+#include "previewrenderer.h"
+#include "markdownconverter.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+PreviewDocument::PreviewDocument(QObject *parent)
+    : QTextDocument(parent)
+{
+}
+
+QVariant PreviewDocument::loadResource(int type, const QUrl &name)
+{
+    // Without a parent the base class would synchronously read images from disk
+    // on the render thread; leave them for the browser to load once attached
+    if (!parent()) {
+        return QVariant();
+    }
+    return QTextDocument::loadResource(type, name);
+}
+
+PreviewRenderer::PreviewRenderer(QThread *resultThread)
+    : QObject(nullptr)
+    , resultThread(resultThread)
+    , hasPending(false)
+    , wakeupPosted(false)
+    , hasReady(false)
+{
+}
+
+PreviewRenderer::~PreviewRenderer()
+{
+    // A finished document nobody picked up
+    delete ready.document;
+}
+
+void PreviewRenderer::request(const Request &request)
+{
+    QMutexLocker locker(&mutex);
+    pending = request;
+    hasPending = true;
+
+    // Requests arriving while one is being rendered collapse into the latest
+    if (!wakeupPosted) {
+        wakeupPosted = true;
+        QMetaObject::invokeMethod(this, &PreviewRenderer::processPending, Qt::QueuedConnection);
+    }
+}
+
+bool PreviewRenderer::takeResult(Result *result)
+{
+    QMutexLocker locker(&mutex);
+    if (!hasReady) {
+        return false;
+    }
+
+    *result = ready;
+    ready = Result();
+    hasReady = false;
+    return true;
+}
+
+void PreviewRenderer::processPending()
+{
+    Request request;
+    {
+        QMutexLocker locker(&mutex);
+        wakeupPosted = false;
+        if (!hasPending) {
+            return;
+        }
+        request = pending;
+        pending = Request();
+        hasPending = false;
+    }
+
+    Result result;
+    result.generation = request.generation;
+    result.markdown = request.markdown;
+    result.html = request.html;
+    if (result.html.isEmpty()) {
+        result.html = MarkdownConverter::markdownToHtml(request.markdown);
+        result.converted = true;
+    }
+
+    if (request.buildDocument) {
+        PreviewDocument *document = new PreviewDocument();
+        document->setUndoRedoEnabled(false);
+        document->setDefaultFont(request.font);
+        document->setDefaultStyleSheet(request.styleSheet);
+        document->setHtml(result.html);
+
+        // Must be pushed from the thread that currently owns the document
+        document->moveToThread(resultThread);
+        result.document = document;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        if (hasReady && ready.document) {
+            // Superseded before the GUI thread picked it up
+            ready.document->deleteLater();
+        }
+        ready = result;
+        hasReady = true;
+    }
+
+    emit resultReady();
+}
@@ -0,0 +1,74 @@
+#ifndef PREVIEWRENDERER_H
+#define PREVIEWRENDERER_H
+
+#include <QObject>
+#include <QFont>
+#include <QMutex>
+#include <QString>
+#include <QTextDocument>
+
+class QThread;
+
+// Document built on the render thread; resources are resolved by the browser once attached
+class PreviewDocument : public QTextDocument
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewDocument(QObject *parent = nullptr);
+
+protected:
+    QVariant loadResource(int type, const QUrl &name) override;
+};
+
+// Lives on the preview's render thread. Converts markdown and builds the
+// QTextDocument there, then hands the finished document to the GUI thread.
+class PreviewRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        quint64 generation = 0;
+        QString markdown;
+        QString html;  // when set, conversion is skipped
+        QString styleSheet;
+        QFont font;
+        bool buildDocument = true;
+    };
+
+    struct Result
+    {
+        quint64 generation = 0;
+        QString markdown;
+        QString html;
+        bool converted = false;
+        QTextDocument *document = nullptr;  // owned by the caller of takeResult
+    };
+
+    explicit PreviewRenderer(QThread *resultThread);
+    ~PreviewRenderer();
+
+    // Callable from any thread; replaces a request that has not started yet
+    void request(const Request &request);
+    bool takeResult(Result *result);
+
+signals:
+    void resultReady();
+
+private slots:
+    void processPending();
+
+private:
+    QThread *resultThread;
+
+    QMutex mutex;
+    Request pending;
+    bool hasPending;
+    bool wakeupPosted;
+    Result ready;
+    bool hasReady;
+};
+
+#endif // PREVIEWRENDERER_H
@@ -2,7 +2,11 @@
 #define PREVIEWWIDGET_H
 
 #include <QWidget>
-#include <QTextBrowser>
+#include <QThread>
+
+class PreviewBrowser;
+class PreviewRenderer;
+class QTextDocument;
 
 class PreviewWidget : public QWidget
 {
@@ -12,26 +16,37 @@ public:
     explicit PreviewWidget(QWidget *parent = nullptr);
     ~PreviewWidget();
 
-    void updatePreview(const QString &markdown);
+    // Returns the generation previewRendered reports for this request
+    quint64 updatePreview(const QString &markdown);
+    void showHtml(const QString &html);
     void scrollToPercentage(double percentage);
+    void setCurrentFilePath(const QString &path);
+    bool setThemeFile(const QString &filePath);
+    QString themeFile() const;
+
+    static QString themesDirectory();
+
+signals:
+    void previewRendered(quint64 generation, const QString &markdown, const QString &html);
+
+private slots:
+    void onRenderResultReady();
 
 private:
-    QString markdownToHtml(const QString &markdown);
-    QString getStyleSheet();
-    QString processEmojis(const QString &text);
-    QString processCodeBlocks(const QString &text);
-    QString processTables(const QString &text);
-    QString convertTableToHtml(const QStringList &tableLines);
-    QString processYamlFrontMatter(const QString &text);
-    QString escapeHtmlInText(const QString &text);
-    QString restoreEscapedHtml(const QString &text);
-    QString processBackslashEscapes(const QString &text);
-    QString processAutolinks(const QString &text);
-    QString processBlockquotes(const QString &text);
-    QString processLists(const QString &text);
-    QString processInlineCode(const QString &text);
-
-    QTextBrowser *webView;
+    quint64 requestRender(const QString &markdown, const QString &html);
+    void attachDocument(QTextDocument *document);
+    static QString getStyleSheet();
+
+    PreviewBrowser *webView;
+    QString currentHtml;
+    QString themeFilePath;
+    QString themeStyleSheet;
+
+    // Conversion and document building happen on the render thread
+    QThread renderThread;
+    PreviewRenderer *renderer;
+    quint64 requestedGeneration;
+    bool buildDocumentsOffThread;
 };
 
 #endif // PREVIEWWIDGET_H
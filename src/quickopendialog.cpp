@@ -0,0 +1,103 @@
+#include "quickopendialog.h"
+#include "pathindex.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+
+QuickOpenDialog::QuickOpenDialog(PathIndex *pathIndex, QWidget *parent)
+    : QDialog(parent)
+    , pathIndex(pathIndex)
+{
+    setWindowTitle(tr("Quick Open"));
+    resize(560, 400);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText(tr("Type part of a file name"));
+    connect(queryEdit, &QLineEdit::textChanged, this, &QuickOpenDialog::updateResults);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &QuickOpenDialog::openSelected);
+    layout->addWidget(queryEdit);
+
+    resultList = new QListWidget(this);
+    resultList->setUniformItemSizes(true);
+    connect(resultList, &QListWidget::itemActivated, this, &QuickOpenDialog::openSelected);
+    layout->addWidget(resultList);
+
+    statusLabel = new QLabel(this);
+    statusLabel->setStyleSheet("QLabel { color: #666; font-size: 10px; }");
+    layout->addWidget(statusLabel);
+
+    // Arrow keys move through the results while typing continues in the query
+    queryEdit->installEventFilter(this);
+
+    // The path list is rebuilt in the background; refresh once it lands
+    connect(pathIndex, &PathIndex::built, this, &QuickOpenDialog::updateResults);
+}
+
+void QuickOpenDialog::popup()
+{
+    queryEdit->clear();
+    updateResults();
+    show();
+    raise();
+    activateWindow();
+    queryEdit->setFocus();
+}
+
+void QuickOpenDialog::updateResults()
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<PathIndex::Match> matches = pathIndex->match(queryEdit->text());
+    double elapsedMs = timer.nsecsElapsed() / 1000000.0;
+
+    resultList->clear();
+    for (const PathIndex::Match &match : matches) {
+        QListWidgetItem *item = new QListWidgetItem(match.relativePath, resultList);
+        item->setData(Qt::UserRole, match.filePath);
+        item->setToolTip(match.filePath);
+    }
+    if (resultList->count() > 0) {
+        resultList->setCurrentRow(0);
+    }
+
+    QString status = tr("%1 files, %2 ms").arg(pathIndex->pathCount()).arg(elapsedMs, 0, 'f', 1);
+    if (pathIndex->isBuilding()) {
+        status += tr(", scanning folder...");
+    }
+    statusLabel->setText(status);
+}
+
+void QuickOpenDialog::openSelected()
+{
+    QListWidgetItem *item = resultList->currentItem();
+    if (!item) {
+        return;
+    }
+    hide();
+    emit fileSelected(item->data(Qt::UserRole).toString());
+}
+
+bool QuickOpenDialog::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == queryEdit && event->type() == QEvent::KeyPress) {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        switch (keyEvent->key()) {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent(resultList, event);
+            return true;
+        default:
+            break;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
@@ -0,0 +1,40 @@
+#ifndef QUICKOPENDIALOG_H
+#define QUICKOPENDIALOG_H
+
+#include <QDialog>
+
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class PathIndex;
+
+// Ctrl+P file finder: fuzzy-matches the typed text against every path under
+// the current folder and opens the selected file
+class QuickOpenDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit QuickOpenDialog(PathIndex *pathIndex, QWidget *parent = nullptr);
+
+    // Shows the dialog with an empty query
+    void popup();
+
+signals:
+    void fileSelected(const QString &filePath);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void updateResults();
+    void openSelected();
+
+private:
+    PathIndex *pathIndex;
+    QLineEdit *queryEdit;
+    QListWidget *resultList;
+    QLabel *statusLabel;
+};
+
+#endif // QUICKOPENDIALOG_H
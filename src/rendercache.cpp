@@ -0,0 +1,127 @@
+#include "rendercache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+// Bump when the markdown to html conversion changes so stale disk entries are ignored
+const int RenderVersion = 1;
+
+const qint64 DefaultMemoryBudget = 64 * 1024 * 1024;
+const int MaxDiskEntries = 500;
+// The cache directory is listed again after this many new entries
+const int PruneInterval = 50;
+
+int entryCost(const RenderCache::Entry &entry)
+{
+    qint64 bytes = (entry.content.size() + entry.html.size()) * qint64(sizeof(QChar));
+    return int(qMax<qint64>(1, bytes / 1024));
+}
+
+} // namespace
+
+RenderCache::RenderCache()
+    : diskCacheEnabled(false)
+    , writesSincePrune(0)
+{
+    prunePool.setMaxThreadCount(1);
+    setMemoryBudget(DefaultMemoryBudget);
+    diskCacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/render";
+}
+
+void RenderCache::setMemoryBudget(qint64 bytes)
+{
+    entries.setMaxCost(int(qMax<qint64>(1, bytes / 1024)));
+}
+
+void RenderCache::setDiskCacheEnabled(bool enabled)
+{
+    diskCacheEnabled = enabled;
+    if (enabled) {
+        QDir().mkpath(diskCacheDirectory);
+        QString directory = diskCacheDirectory;
+        prunePool.start([directory]() { pruneDiskCache(directory); });
+    }
+}
+
+bool RenderCache::find(const QString &filePath, const QDateTime &modified, qint64 size, Entry *entry) const
+{
+    const Entry *cached = entries.object(filePath);
+    if (!cached || cached->modified != modified || cached->size != size) {
+        return false;
+    }
+
+    *entry = *cached;
+    return true;
+}
+
+QString RenderCache::findHtmlOnDisk(const QString &filePath, const QByteArray &hash) const
+{
+    if (!diskCacheEnabled) {
+        return QString();
+    }
+
+    QFile file(diskCachePath(filePath, hash));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll());
+}
+
+void RenderCache::insert(const QString &filePath, const Entry &entry)
+{
+    if (entry.html.isEmpty()) {
+        return;
+    }
+
+    entries.insert(filePath, new Entry(entry), entryCost(entry));
+
+    if (diskCacheEnabled) {
+        QSaveFile file(diskCachePath(filePath, entry.hash));
+        if (!QFile::exists(file.fileName()) && file.open(QIODevice::WriteOnly)) {
+            file.write(entry.html.toUtf8());
+            if (file.commit() && ++writesSincePrune >= PruneInterval) {
+                writesSincePrune = 0;
+                QString directory = diskCacheDirectory;
+                prunePool.start([directory]() { pruneDiskCache(directory); });
+            }
+        }
+    }
+}
+
+void RenderCache::remove(const QString &filePath)
+{
+    entries.remove(filePath);
+}
+
+QByteArray RenderCache::contentHash(const QString &content)
+{
+    // Hash the UTF-16 data in place rather than converting to UTF-8 first
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(content.constData()),
+                                         content.size() * qsizetype(sizeof(QChar))));
+    return hash.result();
+}
+
+QString RenderCache::diskCachePath(const QString &filePath, const QByteArray &hash) const
+{
+    QCryptographicHash key(QCryptographicHash::Sha1);
+    key.addData(QByteArray::number(RenderVersion));
+    key.addData(filePath.toUtf8());
+    key.addData(hash);
+    return diskCacheDirectory + "/" + QString::fromLatin1(key.result().toHex()) + ".html";
+}
+
+void RenderCache::pruneDiskCache(const QString &directory)
+{
+    // Drop the least recently written entries once the cache grows past its limit
+    QDir dir(directory);
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.html", QDir::Files, QDir::Time);
+    for (int i = MaxDiskEntries; i < files.size(); ++i) {
+        QFile::remove(files[i].absoluteFilePath());
+    }
+}
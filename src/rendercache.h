@@ -0,0 +1,49 @@
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QCache>
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QThreadPool>
+
+class RenderCache
+{
+public:
+    struct Entry
+    {
+        QDateTime modified;
+        qint64 size = 0;
+        QByteArray hash;
+        QString content;
+        QString html;
+    };
+
+    RenderCache();
+
+    void setMemoryBudget(qint64 bytes);
+    void setDiskCacheEnabled(bool enabled);
+
+    // Memory lookup; only hits while the file's mtime and size are unchanged
+    bool find(const QString &filePath, const QDateTime &modified, qint64 size, Entry *entry) const;
+    // Disk lookup of previously rendered html for the given file content
+    QString findHtmlOnDisk(const QString &filePath, const QByteArray &hash) const;
+
+    void insert(const QString &filePath, const Entry &entry);
+    void remove(const QString &filePath);
+
+    static QByteArray contentHash(const QString &content);
+
+private:
+    QString diskCachePath(const QString &filePath, const QByteArray &hash) const;
+    // Runs on prunePool
+    static void pruneDiskCache(const QString &directory);
+
+    QCache<QString, Entry> entries;  // cost in kilobytes
+    bool diskCacheEnabled;
+    QString diskCacheDirectory;
+    int writesSincePrune;
+    QThreadPool prunePool;
+};
+
+#endif // RENDERCACHE_H
@@ -0,0 +1,99 @@
+#include "searchpanel.h"
+#include "workspaceindexer.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+
+SearchPanel::SearchPanel(WorkspaceIndexer *indexer, QWidget *parent)
+    : QWidget(parent)
+    , indexer(indexer)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 5, 0, 0);
+    layout->setSpacing(5);
+
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText(tr("Search in files"));
+    queryEdit->setClearButtonEnabled(true);
+    connect(queryEdit, &QLineEdit::textChanged, this, &SearchPanel::runSearch);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &SearchPanel::openFirstResult);
+    layout->addWidget(queryEdit);
+
+    statusLabel = new QLabel(this);
+    statusLabel->setStyleSheet("QLabel { color: #666; font-size: 10px; }");
+    layout->addWidget(statusLabel);
+
+    resultList = new QListWidget(this);
+    resultList->setUniformItemSizes(true);
+    connect(resultList, &QListWidget::itemClicked, this, &SearchPanel::onItemActivated);
+    connect(resultList, &QListWidget::itemActivated, this, &SearchPanel::onItemActivated);
+    layout->addWidget(resultList);
+
+    connect(indexer, &WorkspaceIndexer::indexingProgress, this, &SearchPanel::onIndexingProgress);
+    connect(indexer, &WorkspaceIndexer::indexingFinished, this, &SearchPanel::runSearch);
+}
+
+void SearchPanel::focusQuery()
+{
+    queryEdit->setFocus();
+    queryEdit->selectAll();
+}
+
+void SearchPanel::runSearch()
+{
+    resultList->clear();
+
+    QString query = queryEdit->text();
+    if (query.trimmed().isEmpty()) {
+        if (indexer->isIndexing()) {
+            statusLabel->setText(tr("Indexing..."));
+        } else {
+            statusLabel->setText(tr("%1 files indexed").arg(indexer->fileCount()));
+        }
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<WorkspaceIndexer::Match> matches = indexer->search(query);
+    double elapsedMs = timer.nsecsElapsed() / 1000000.0;
+
+    QDir root(indexer->rootPath());
+    for (const WorkspaceIndexer::Match &match : matches) {
+        QListWidgetItem *item = new QListWidgetItem(root.relativeFilePath(match.filePath), resultList);
+        item->setData(Qt::UserRole, match.filePath);
+        item->setToolTip(tr("%1\n%2 matches").arg(match.filePath).arg(match.hits));
+    }
+
+    QString status = tr("%1 files (%2 ms)").arg(matches.size()).arg(elapsedMs, 0, 'f', 1);
+    if (indexer->isIndexing()) {
+        status += tr(", still indexing");
+    }
+    statusLabel->setText(status);
+}
+
+void SearchPanel::openFirstResult()
+{
+    if (resultList->count() > 0) {
+        onItemActivated(resultList->item(0));
+    }
+}
+
+void SearchPanel::onItemActivated(QListWidgetItem *item)
+{
+    emit fileSelected(item->data(Qt::UserRole).toString());
+}
+
+void SearchPanel::onIndexingProgress(int filesIndexed)
+{
+    // Results fill in while the first walk is still running
+    if (!queryEdit->text().trimmed().isEmpty()) {
+        runSearch();
+    } else {
+        statusLabel->setText(tr("Indexing... %1 files read").arg(filesIndexed));
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef SEARCHPANEL_H
+#define SEARCHPANEL_H
+
+#include <QWidget>
+
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+class WorkspaceIndexer;
+
+// Search box over the workspace index; results update as the query is typed
+class SearchPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SearchPanel(WorkspaceIndexer *indexer, QWidget *parent = nullptr);
+
+    void focusQuery();
+
+signals:
+    void fileSelected(const QString &filePath);
+
+private slots:
+    void runSearch();
+    void openFirstResult();
+    void onItemActivated(QListWidgetItem *item);
+    void onIndexingProgress(int filesIndexed);
+
+private:
+    WorkspaceIndexer *indexer;
+    QLineEdit *queryEdit;
+    QListWidget *resultList;
+    QLabel *statusLabel;
+};
+
+#endif // SEARCHPANEL_H
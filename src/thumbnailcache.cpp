@@ -0,0 +1,177 @@
+#include "thumbnailcache.h"
+#include "diagnostics.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QPixmap>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+// Stored on disk at up to this size, for hover previews
+const int ThumbnailSize = 256;
+// Kept in memory at this size, for the tree; twice the row icon for high-DPI screens
+const int IconSize = 48;
+const int MaxCachedIcons = 2000;
+// Enough for every icon kept in memory to have its larger version on disk
+const int MaxDiskThumbnails = MaxCachedIcons;
+// The cache directory is listed again after this many thumbnails are made
+const int PruneInterval = 200;
+// Failures are forgotten wholesale beyond this many
+const int MaxFailedKeys = 2000;
+
+} // namespace
+
+ThumbnailCache::ThumbnailCache(QObject *parent)
+    : QObject(parent)
+    , generatedSincePrune(0)
+{
+    icons.setMaxCost(MaxCachedIcons);
+    pool.setMaxThreadCount(2);
+    pool.start(&ThumbnailCache::pruneDiskCache);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    // Results posted by running tasks are discarded together with this object
+    pool.clear();
+    pool.waitForDone();
+}
+
+bool ThumbnailCache::isImageFile(const QString &filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "png" || suffix == "jpg" || suffix == "jpeg" || suffix == "gif"
+        || suffix == "bmp" || suffix == "svg" || suffix == "webp" || suffix == "ico";
+}
+
+QIcon ThumbnailCache::icon(const QString &filePath, const QDateTime &modified, qint64 size)
+{
+    QString key = cacheKey(filePath, modified, size);
+    if (QIcon *cached = icons.object(key)) {
+        return *cached;
+    }
+    request(key, filePath);
+    return QIcon();
+}
+
+QString ThumbnailCache::thumbnailPath(const QString &filePath, const QDateTime &modified, qint64 size)
+{
+    // The icon and the file on disk are made together
+    QString key = cacheKey(filePath, modified, size);
+    if (icons.contains(key)) {
+        return diskPath(key);
+    }
+    request(key, filePath);
+    return QString();
+}
+
+void ThumbnailCache::request(const QString &key, const QString &filePath)
+{
+    if (pendingKeys.contains(key) || failedKeys.contains(key)) {
+        return;
+    }
+    pendingKeys.insert(key);
+
+    QString thumbnailFile = diskPath(key);
+    pool.start([this, key, filePath, thumbnailFile]() {
+        QImage iconImage = generate(filePath, thumbnailFile);
+        QMetaObject::invokeMethod(this, [this, key, filePath, iconImage]() {
+            onGenerated(key, filePath, iconImage);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ThumbnailCache::onGenerated(const QString &key, const QString &filePath, const QImage &iconImage)
+{
+    pendingKeys.remove(key);
+    if (iconImage.isNull()) {
+        if (failedKeys.size() >= MaxFailedKeys) {
+            failedKeys.clear();
+        }
+        failedKeys.insert(key);
+        return;
+    }
+
+    if (++generatedSincePrune >= PruneInterval) {
+        generatedSincePrune = 0;
+        pool.start(&ThumbnailCache::pruneDiskCache);
+    }
+
+    // Pixmaps can only be made on the GUI thread
+    icons.insert(key, new QIcon(QPixmap::fromImage(iconImage)));
+    emit thumbnailReady(filePath);
+}
+
+QImage ThumbnailCache::generate(const QString &filePath, const QString &thumbnailFile)
+{
+    QImage thumbnail;
+    if (QFile::exists(thumbnailFile)) {
+        thumbnail.load(thumbnailFile, "PNG");
+        if (!thumbnail.isNull()) {
+            // Pruning goes by modification time, so this keeps it by last use
+            QFile(thumbnailFile).setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+            Diagnostics::increment("Thumbnails: read from disk cache");
+        }
+    }
+
+    if (thumbnail.isNull()) {
+        // Decoded straight to the thumbnail size where the format allows it
+        QImageReader reader(filePath);
+        reader.setAutoTransform(true);
+        QSize size = reader.size();
+        if (size.isValid() && (size.width() > ThumbnailSize || size.height() > ThumbnailSize)) {
+            reader.setScaledSize(size.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio));
+        }
+        thumbnail = reader.read();
+        if (thumbnail.isNull()) {
+            return QImage();
+        }
+        if (thumbnail.width() > ThumbnailSize || thumbnail.height() > ThumbnailSize) {
+            thumbnail = thumbnail.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        Diagnostics::increment("Thumbnails: decoded");
+
+        QDir().mkpath(QFileInfo(thumbnailFile).absolutePath());
+        QSaveFile file(thumbnailFile);
+        if (file.open(QIODevice::WriteOnly) && thumbnail.save(&file, "PNG")) {
+            file.commit();
+        }
+    }
+
+    if (thumbnail.width() <= IconSize && thumbnail.height() <= IconSize) {
+        return thumbnail;
+    }
+    return thumbnail.scaled(IconSize, IconSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+QString ThumbnailCache::cacheKey(const QString &filePath, const QDateTime &modified, qint64 size)
+{
+    QByteArray source = filePath.toUtf8() + '|' + QByteArray::number(modified.toMSecsSinceEpoch())
+        + '|' + QByteArray::number(size);
+    return QString::fromLatin1(QCryptographicHash::hash(source, QCryptographicHash::Sha1).toHex());
+}
+
+QString ThumbnailCache::diskPath(const QString &key)
+{
+    return diskDirectory() + "/" + key + ".png";
+}
+
+QString ThumbnailCache::diskDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+}
+
+void ThumbnailCache::pruneDiskCache()
+{
+    // Drop the least recently used thumbnails once the cache grows past its limit
+    QDir dir(diskDirectory());
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.png", QDir::Files, QDir::Time);
+    for (int i = MaxDiskThumbnails; i < files.size(); ++i) {
+        QFile::remove(files[i].absoluteFilePath());
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QDateTime>
+#include <QIcon>
+#include <QImage>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+// Thumbnails of image files for the file browser. Images are decoded and
+// downscaled on worker threads and the result is written to the cache
+// directory, keyed by path, mtime and size, so browsing the same folder
+// again costs a small PNG read instead of a full decode. Callers get a null
+// result while a thumbnail is being made and thumbnailReady once it is.
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ThumbnailCache(QObject *parent = nullptr);
+    ~ThumbnailCache();
+
+    // Small icon for the file tree
+    QIcon icon(const QString &filePath, const QDateTime &modified, qint64 size);
+    // The thumbnail image on disk, e.g. for a tooltip
+    QString thumbnailPath(const QString &filePath, const QDateTime &modified, qint64 size);
+
+    static bool isImageFile(const QString &filePath);
+
+signals:
+    void thumbnailReady(const QString &filePath);
+
+private:
+    void request(const QString &key, const QString &filePath);
+    void onGenerated(const QString &key, const QString &filePath, const QImage &iconImage);
+
+    static QString cacheKey(const QString &filePath, const QDateTime &modified, qint64 size);
+    static QString diskPath(const QString &key);
+    static QString diskDirectory();
+    // Runs on the pool; deletes the oldest thumbnails beyond the limit
+    static void pruneDiskCache();
+    // Runs on the pool; returns the icon-sized image, null on failure
+    static QImage generate(const QString &filePath, const QString &thumbnailFile);
+
+    QCache<QString, QIcon> icons;
+    QSet<QString> pendingKeys;
+    QSet<QString> failedKeys;
+    int generatedSincePrune;
+    QThreadPool pool;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,939 @@
+#include "workspaceindexer.h"
+#include "filedecoder.h"
+#include "diagnostics.h"
+#include "ignorerules.h"
+#include "markdownlinks.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+namespace {
+
+const quint32 IndexMagic = 0x4d445831;  // "MDX1"
+const quint32 IndexVersion = 2;
+
+// Updates are applied in batches, so searches are never locked out for long
+const int UpdateBatchSize = 256;
+
+// Larger files are listed without their words rather than read whole
+const qint64 MaxIndexedFileSize = 16 * 1024 * 1024;
+
+const int MinimumWordLength = 2;
+const int MaximumWordLength = 64;
+
+// Directory watches are a limited system resource
+const int MaxWatchedDirectories = 2048;
+
+// Lowercased runs of letters and digits, in order
+QStringList splitWords(const QString &text)
+{
+    QStringList words;
+    const QChar *data = text.constData();
+    qsizetype length = text.size();
+    qsizetype start = -1;
+
+    for (qsizetype i = 0; i <= length; ++i) {
+        if (i < length && data[i].isLetterOrNumber()) {
+            if (start < 0) {
+                start = i;
+            }
+            continue;
+        }
+        if (start >= 0) {
+            qsizetype wordLength = i - start;
+            if (wordLength >= MinimumWordLength && wordLength <= MaximumWordLength) {
+                words.append(QString(data + start, wordLength).toLower());
+            }
+            start = -1;
+        }
+    }
+    return words;
+}
+
+} // namespace
+
+struct WorkspaceIndexer::ScanJob
+{
+    QString rootPath;
+    QStringList ignorePatterns;
+    bool reset = false;  // start from the cached index instead of the current one
+    // Only these folders changed; empty walks the whole tree
+    QStringList directories;
+    QSet<QString> watchedDirectories;
+    qint64 started = 0;
+    qint64 previousScanStarted = 0;
+    std::atomic<bool> cancelled{false};
+};
+
+WorkspaceIndexer::WorkspaceIndexer(QObject *parent)
+    : QObject(parent)
+    , lastScanStarted(0)
+    , liveFiles(0)
+{
+    pool.setMaxThreadCount(1);
+
+    // Added, removed and atomically saved files show up as directory changes;
+    // only the folders they happen in are listed again
+    directoryWatcher = new QFileSystemWatcher(this);
+    rescanTimer = new QTimer(this);
+    rescanTimer->setSingleShot(true);
+    rescanTimer->setInterval(1000);
+    connect(directoryWatcher, &QFileSystemWatcher::directoryChanged, this, [this](const QString &path) {
+        changedDirectories.insert(path);
+        rescanTimer->start();
+    });
+    connect(rescanTimer, &QTimer::timeout, this, [this]() {
+        QStringList directories(changedDirectories.begin(), changedDirectories.end());
+        changedDirectories.clear();
+        rescanDirectories(directories);
+    });
+}
+
+WorkspaceIndexer::~WorkspaceIndexer()
+{
+    if (scanJob) {
+        scanJob->cancelled = true;
+    }
+    pool.clear();
+    pool.waitForDone();
+}
+
+void WorkspaceIndexer::setRootPath(const QString &path)
+{
+    QString absolutePath = QDir(path).absolutePath();
+    if (absolutePath == root) {
+        return;
+    }
+    root = absolutePath;
+    changedDirectories.clear();
+    rescanTimer->stop();
+
+    if (!directoryWatcher->directories().isEmpty()) {
+        directoryWatcher->removePaths(directoryWatcher->directories());
+    }
+    startScan(true);
+}
+
+QString WorkspaceIndexer::rootPath() const
+{
+    return root;
+}
+
+void WorkspaceIndexer::setIgnorePatterns(const QStringList &patterns)
+{
+    // Used from the next scan on
+    ignorePatterns = patterns;
+}
+
+void WorkspaceIndexer::rescan()
+{
+    if (!root.isEmpty()) {
+        startScan(false);
+    }
+}
+
+void WorkspaceIndexer::rescanDirectories(const QStringList &directories)
+{
+    if (root.isEmpty() || directories.isEmpty()) {
+        return;
+    }
+
+    QStringList pending = directories;
+    if (scanJob) {
+        if (scanJob->directories.isEmpty()) {
+            // A full walk may already be past these folders; start it over
+            startScan(false);
+            return;
+        }
+        scanJob->cancelled = true;
+        pending += scanJob->directories;
+        pending.removeDuplicates();
+    }
+
+    auto job = std::make_shared<ScanJob>();
+    job->rootPath = root;
+    job->ignorePatterns = ignorePatterns;
+    job->directories = pending;
+    const QStringList watched = directoryWatcher->directories();
+    job->watchedDirectories = QSet<QString>(watched.begin(), watched.end());
+    job->started = QDateTime::currentMSecsSinceEpoch();
+    job->previousScanStarted = lastScanStarted;
+    scanJob = job;
+
+    pool.start([this, job]() { scanDirectories(job); });
+}
+
+void WorkspaceIndexer::updateFile(const QString &filePath)
+{
+    QString absolutePath = QFileInfo(filePath).absoluteFilePath();
+    if (root.isEmpty() || !absolutePath.startsWith(root + QLatin1Char('/'))) {
+        return;
+    }
+    if (!absolutePath.endsWith(".md", Qt::CaseInsensitive)
+            && !absolutePath.endsWith(".markdown", Qt::CaseInsensitive)) {
+        return;
+    }
+
+    pool.start([this, absolutePath]() {
+        QFileInfo fileInfo(absolutePath);
+        Update update;
+        if (!readFile(absolutePath, fileInfo.lastModified().toMSecsSinceEpoch(), fileInfo.size(), &update)) {
+            return;
+        }
+        QWriteLocker locker(&lock);
+        applyUpdate(update);
+    });
+}
+
+QStringList WorkspaceIndexer::backlinks(const QString &filePath) const
+{
+    QString absolutePath = QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+    QStringList sources;
+    {
+        QReadLocker locker(&lock);
+        for (int file : linkSources.value(absolutePath)) {
+            sources.append(files[file].filePath);
+        }
+    }
+    sources.sort();
+    return sources;
+}
+
+bool WorkspaceIndexer::anchors(const QString &filePath, QStringList *anchors) const
+{
+    QString absolutePath = QDir::cleanPath(QFileInfo(filePath).absoluteFilePath());
+    QReadLocker locker(&lock);
+    int file = fileIds.value(absolutePath, -1);
+    if (file < 0) {
+        return false;
+    }
+    *anchors = files[file].anchors;
+    return true;
+}
+
+bool WorkspaceIndexer::isIndexing() const
+{
+    return scanJob != nullptr;
+}
+
+int WorkspaceIndexer::fileCount() const
+{
+    QReadLocker locker(&lock);
+    return liveFiles;
+}
+
+QVector<WorkspaceIndexer::Match> WorkspaceIndexer::search(const QString &query, int maxResults) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList words = splitWords(query);
+    if (words.isEmpty()) {
+        return QVector<Match>();
+    }
+
+    QReadLocker locker(&lock);
+
+    // Hits per file; a file stays only while it contains every word so far
+    QHash<int, int> scores;
+    for (int i = 0; i < words.size(); ++i) {
+        QHash<int, int> wordHits;
+        auto addPostings = [this, &wordHits](int term) {
+            for (const Posting &posting : postings[term]) {
+                wordHits[posting.file] += posting.count;
+            }
+        };
+
+        const QString &word = words[i];
+        if (i + 1 < words.size()) {
+            int term = termIds.value(word, -1);
+            if (term >= 0) {
+                addPostings(term);
+            }
+        } else {
+            auto first = std::lower_bound(sortedTerms.begin(), sortedTerms.end(), word,
+                                          [this](int term, const QString &value) {
+                return terms[term] < value;
+            });
+            for (auto it = first; it != sortedTerms.end() && terms[*it].startsWith(word); ++it) {
+                addPostings(*it);
+            }
+            for (int term = sortedTerms.size(); term < terms.size(); ++term) {
+                if (terms[term].startsWith(word)) {
+                    addPostings(term);
+                }
+            }
+        }
+
+        if (i == 0) {
+            scores = wordHits;
+        } else {
+            QHash<int, int> combined;
+            for (auto it = scores.constBegin(); it != scores.constEnd(); ++it) {
+                auto hit = wordHits.constFind(it.key());
+                if (hit != wordHits.constEnd()) {
+                    combined.insert(it.key(), it.value() + hit.value());
+                }
+            }
+            scores = combined;
+        }
+        if (scores.isEmpty()) {
+            break;
+        }
+    }
+
+    QVector<Match> matches;
+    matches.reserve(scores.size());
+    for (auto it = scores.constBegin(); it != scores.constEnd(); ++it) {
+        Match match;
+        match.filePath = files[it.key()].filePath;
+        match.hits = it.value();
+        matches.append(match);
+    }
+    locker.unlock();
+
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        if (a.hits != b.hits) {
+            return a.hits > b.hits;
+        }
+        return a.filePath < b.filePath;
+    });
+    if (matches.size() > maxResults) {
+        matches.resize(maxResults);
+    }
+
+    Diagnostics::recordDuration("Workspace search", timer.nsecsElapsed() / 1000);
+    return matches;
+}
+
+void WorkspaceIndexer::startScan(bool reset)
+{
+    if (scanJob) {
+        // A reset that never got to run still has to happen
+        scanJob->cancelled = true;
+        reset = reset || scanJob->reset;
+    }
+
+    auto job = std::make_shared<ScanJob>();
+    job->rootPath = root;
+    job->ignorePatterns = ignorePatterns;
+    job->reset = reset;
+    job->started = QDateTime::currentMSecsSinceEpoch();
+    scanJob = job;
+
+    pool.start([this, job]() { scan(job); });
+}
+
+void WorkspaceIndexer::scan(std::shared_ptr<ScanJob> job)
+{
+    // Runs on the pool thread, the only one that modifies the index
+    if (job->cancelled) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    bool changed = false;
+
+    if (job->reset) {
+        {
+            QWriteLocker locker(&lock);
+            clearIndex();
+        }
+        changed = !loadIndex(job->rootPath);
+    }
+
+    // What the index holds now, to skip unchanged files and find removed ones
+    QHash<QString, QPair<qint64, qint64>> known;
+    {
+        QReadLocker locker(&lock);
+        for (const FileEntry &entry : files) {
+            if (!entry.filePath.isEmpty()) {
+                known.insert(entry.filePath, qMakePair(entry.modified, entry.size));
+            }
+        }
+    }
+
+    QSet<QString> directories;
+    directories.insert(job->rootPath);
+    QVector<Update> batch;
+    int indexed = 0;
+
+    auto applyBatch = [this, job, &batch, &indexed, &changed]() {
+        {
+            QWriteLocker locker(&lock);
+            for (const Update &update : batch) {
+                applyUpdate(update);
+            }
+        }
+        indexed += batch.size();
+        changed = true;
+        batch.clear();
+
+        int total = indexed;
+        QMetaObject::invokeMethod(this, [this, job, total]() {
+            if (job == scanJob) {
+                emit indexingProgress(total);
+            }
+        }, Qt::QueuedConnection);
+    };
+
+    IgnoreRules ignoreRules;
+    ignoreRules.setRootPath(job->rootPath);
+    ignoreRules.setExtraPatterns(job->ignorePatterns);
+
+    bool complete = ignoreRules.forEachFile(QStringList() << "*.md" << "*.markdown", [&](const QFileInfo &fileInfo) {
+        if (job->cancelled) {
+            return false;
+        }
+
+        QString filePath = fileInfo.filePath();
+        if (directories.size() < MaxWatchedDirectories) {
+            directories.insert(fileInfo.absolutePath());
+        }
+
+        qint64 modified = fileInfo.lastModified().toMSecsSinceEpoch();
+        qint64 size = fileInfo.size();
+        auto stamp = known.find(filePath);
+        if (stamp != known.end()) {
+            bool unchanged = stamp->first == modified && stamp->second == size;
+            known.erase(stamp);
+            if (unchanged) {
+                return true;
+            }
+        }
+
+        Update update;
+        if (readFile(filePath, modified, size, &update)) {
+            batch.append(update);
+            if (batch.size() >= UpdateBatchSize) {
+                applyBatch();
+            }
+        }
+        return true;
+    });
+    if (!complete) {
+        return;
+    }
+    if (!batch.isEmpty()) {
+        applyBatch();
+    }
+
+    // Whatever the walk did not come across is gone
+    if (!known.isEmpty()) {
+        QWriteLocker locker(&lock);
+        for (auto stamp = known.constBegin(); stamp != known.constEnd(); ++stamp) {
+            int file = fileIds.value(stamp.key(), -1);
+            if (file >= 0) {
+                removeFile(file);
+            }
+        }
+        changed = true;
+    }
+
+    if (changed) {
+        sortTerms();
+        saveIndex(job->rootPath);
+    }
+    Diagnostics::recordDuration("Workspace index scan", timer.nsecsElapsed() / 1000);
+
+    QStringList watched = directories.values();
+    QMetaObject::invokeMethod(this, [this, job, watched]() {
+        onScanFinished(job, watched);
+    }, Qt::QueuedConnection);
+}
+
+void WorkspaceIndexer::scanDirectories(std::shared_ptr<ScanJob> job)
+{
+    // Runs on the pool thread. Each folder's files are compared with the
+    // index; subfolders are only walked when they appeared since the last
+    // scan, e.g. created or moved in, as older ones have watches of their own.
+    if (job->cancelled) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    IgnoreRules ignoreRules;
+    ignoreRules.setRootPath(job->rootPath);
+    ignoreRules.setExtraPatterns(job->ignorePatterns);
+    const QStringList nameFilters = QStringList() << "*.md" << "*.markdown";
+
+    QVector<Update> updates;
+    QSet<QString> removed;
+    QSet<QString> newDirectories;
+
+    for (const QString &directory : std::as_const(job->directories)) {
+        QString prefix = directory + QLatin1Char('/');
+        QHash<QString, QPair<qint64, qint64>> known;
+        {
+            QReadLocker locker(&lock);
+            for (const FileEntry &entry : files) {
+                if (entry.filePath.startsWith(prefix)) {
+                    known.insert(entry.filePath, qMakePair(entry.modified, entry.size));
+                }
+            }
+        }
+
+        auto visit = [&](const QFileInfo &fileInfo) {
+            if (job->cancelled) {
+                return false;
+            }
+            QString filePath = fileInfo.filePath();
+            if (fileInfo.path() != directory) {
+                newDirectories.insert(fileInfo.path());
+            }
+            qint64 modified = fileInfo.lastModified().toMSecsSinceEpoch();
+            qint64 size = fileInfo.size();
+            auto stamp = known.find(filePath);
+            if (stamp != known.end()) {
+                bool unchanged = stamp->first == modified && stamp->second == size;
+                known.erase(stamp);
+                if (unchanged) {
+                    return true;
+                }
+            }
+            Update update;
+            if (readFile(filePath, modified, size, &update)) {
+                updates.append(update);
+            }
+            return true;
+        };
+
+        QSet<QString> walked;
+        QFileInfo directoryInfo(directory);
+        if (directoryInfo.isDir() && (directory == job->rootPath || !ignoreRules.isIgnored(directory, true))) {
+            QDir dir(directory);
+            const QFileInfoList children = dir.entryInfoList(nameFilters, QDir::Files);
+            for (const QFileInfo &child : children) {
+                if (!ignoreRules.isIgnored(child.filePath(), false) && !visit(child)) {
+                    return;
+                }
+            }
+
+            const QFileInfoList subdirectories = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+            for (const QFileInfo &subdirectory : subdirectories) {
+                QString path = subdirectory.filePath();
+                if (subdirectory.isSymLink() || job->watchedDirectories.contains(path)
+                        || ignoreRules.isIgnored(path, true)) {
+                    continue;
+                }
+                // Moving a folder in updates its change time
+                qint64 changed = qMax(subdirectory.lastModified().toMSecsSinceEpoch(),
+                                      subdirectory.metadataChangeTime().toMSecsSinceEpoch());
+                if (changed < job->previousScanStarted) {
+                    continue;
+                }
+                walked.insert(path);
+                if (!ignoreRules.forEachFile(nameFilters, visit, path)) {
+                    return;
+                }
+            }
+        }
+
+        // Left over: files gone from this folder, or from subfolders walked or removed
+        for (auto stamp = known.constBegin(); stamp != known.constEnd(); ++stamp) {
+            QString relativePath = stamp.key().mid(prefix.size());
+            int slash = relativePath.indexOf(QLatin1Char('/'));
+            QString subdirectory = slash < 0 ? QString() : prefix + relativePath.left(slash);
+            if (subdirectory.isEmpty() || walked.contains(subdirectory) || !QFileInfo::exists(subdirectory)) {
+                removed.insert(stamp.key());
+            }
+        }
+    }
+
+    if (job->cancelled) {
+        return;
+    }
+    if (!updates.isEmpty() || !removed.isEmpty()) {
+        {
+            QWriteLocker locker(&lock);
+            for (const Update &update : std::as_const(updates)) {
+                applyUpdate(update);
+            }
+            for (const QString &filePath : std::as_const(removed)) {
+                int file = fileIds.value(filePath, -1);
+                if (file >= 0) {
+                    removeFile(file);
+                }
+            }
+        }
+        sortTerms();
+        saveIndex(job->rootPath);
+    }
+    Diagnostics::recordDuration("Workspace index folder rescan", timer.nsecsElapsed() / 1000);
+
+    QStringList watched = newDirectories.values();
+    QMetaObject::invokeMethod(this, [this, job, watched]() {
+        onScanFinished(job, watched);
+    }, Qt::QueuedConnection);
+}
+
+void WorkspaceIndexer::onScanFinished(std::shared_ptr<ScanJob> job, const QStringList &directories)
+{
+    if (job != scanJob) {
+        return;
+    }
+    scanJob.reset();
+    lastScanStarted = job->started;
+
+    if (!job->directories.isEmpty()) {
+        // Folders found by a partial rescan are added to the watch, up to the cap
+        QStringList current = directoryWatcher->directories();
+        QStringList added;
+        for (const QString &directory : directories) {
+            if (current.size() + added.size() >= MaxWatchedDirectories) {
+                break;
+            }
+            if (!current.contains(directory)) {
+                added.append(directory);
+            }
+        }
+        if (!added.isEmpty()) {
+            directoryWatcher->addPaths(added);
+        }
+        emit indexingFinished(fileCount());
+        return;
+    }
+
+    // Only the directories that hold markdown files, up to the cap
+    QSet<QString> wanted(directories.begin(), directories.end());
+    QStringList current = directoryWatcher->directories();
+    QStringList removed;
+    for (const QString &directory : current) {
+        if (!wanted.remove(directory)) {
+            removed.append(directory);
+        }
+    }
+    if (!removed.isEmpty()) {
+        directoryWatcher->removePaths(removed);
+    }
+    if (!wanted.isEmpty()) {
+        directoryWatcher->addPaths(QStringList(wanted.begin(), wanted.end()));
+    }
+
+    emit indexingFinished(fileCount());
+}
+
+bool WorkspaceIndexer::readFile(const QString &filePath, qint64 modified, qint64 size, Update *update) const
+{
+    update->filePath = filePath;
+    update->modified = modified;
+    update->size = size;
+    if (size > MaxIndexedFileSize) {
+        return true;
+    }
+
+    QString text;
+    if (!FileDecoder::readFile(filePath, &text, nullptr, FileDecoder::Copy)) {
+        return false;
+    }
+    for (const QString &word : splitWords(text)) {
+        update->terms[word]++;
+    }
+
+    update->anchors = MarkdownLinks::headingAnchors(text);
+    QSet<QString> linked;
+    for (const MarkdownLinks::Link &link : MarkdownLinks::extractLinks(text)) {
+        QString target;
+        QString fragment;
+        if (MarkdownLinks::resolveTarget(filePath, link.target, &target, &fragment)
+                && !target.isEmpty() && !linked.contains(target)) {
+            linked.insert(target);
+            update->links.append(target);
+        }
+    }
+    Diagnostics::increment("Workspace index: files read");
+    return true;
+}
+
+void WorkspaceIndexer::applyUpdate(const Update &update)
+{
+    int file = fileIds.value(update.filePath, -1);
+    if (file < 0) {
+        file = files.size();
+        files.append(FileEntry());
+        fileIds.insert(update.filePath, file);
+        liveFiles++;
+    } else {
+        dropPostings(file);
+    }
+
+    FileEntry &entry = files[file];
+    entry.filePath = update.filePath;
+    entry.modified = update.modified;
+    entry.size = update.size;
+    entry.anchors = update.anchors;
+    entry.links = update.links;
+    entry.terms.reserve(update.terms.size());
+    addLinkSources(file);
+
+    for (auto it = update.terms.constBegin(); it != update.terms.constEnd(); ++it) {
+        int term = termIds.value(it.key(), -1);
+        if (term < 0) {
+            term = terms.size();
+            terms.append(it.key());
+            termIds.insert(it.key(), term);
+            postings.append(QVector<Posting>());
+        }
+
+        // Posting lists stay sorted by file, so removal is a binary search
+        QVector<Posting> &list = postings[term];
+        auto position = std::lower_bound(list.begin(), list.end(), file, [](const Posting &posting, int value) {
+            return posting.file < value;
+        });
+        list.insert(position, Posting{file, it.value()});
+        entry.terms.append(term);
+    }
+}
+
+void WorkspaceIndexer::dropPostings(int file)
+{
+    FileEntry &entry = files[file];
+    for (int term : entry.terms) {
+        QVector<Posting> &list = postings[term];
+        auto position = std::lower_bound(list.begin(), list.end(), file, [](const Posting &posting, int value) {
+            return posting.file < value;
+        });
+        if (position != list.end() && position->file == file) {
+            list.erase(position);
+        }
+    }
+    entry.terms.clear();
+
+    for (const QString &target : std::as_const(entry.links)) {
+        auto sources = linkSources.find(target);
+        if (sources == linkSources.end()) {
+            continue;
+        }
+        sources->removeOne(file);
+        if (sources->isEmpty()) {
+            linkSources.erase(sources);
+        }
+    }
+    entry.links.clear();
+    entry.anchors.clear();
+}
+
+void WorkspaceIndexer::addLinkSources(int file)
+{
+    for (const QString &target : std::as_const(files[file].links)) {
+        linkSources[target].append(file);
+    }
+}
+
+void WorkspaceIndexer::removeFile(int file)
+{
+    // The slot stays empty until the index is next saved and reloaded
+    dropPostings(file);
+    fileIds.remove(files[file].filePath);
+    files[file] = FileEntry();
+    liveFiles--;
+}
+
+void WorkspaceIndexer::clearIndex()
+{
+    files.clear();
+    fileIds.clear();
+    terms.clear();
+    termIds.clear();
+    postings.clear();
+    sortedTerms.clear();
+    linkSources.clear();
+    liveFiles = 0;
+}
+
+void WorkspaceIndexer::sortTerms()
+{
+    // Sorted outside the lock; terms are only ever appended, so the order stays valid
+    QVector<QString> snapshot;
+    {
+        QReadLocker locker(&lock);
+        snapshot = terms;
+    }
+
+    QVector<int> order(snapshot.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&snapshot](int a, int b) {
+        return snapshot[a] < snapshot[b];
+    });
+
+    QWriteLocker locker(&lock);
+    sortedTerms = order;
+}
+
+bool WorkspaceIndexer::loadIndex(const QString &root)
+{
+    QFile file(indexPath(root));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString storedRoot;
+    qint32 fileCount = 0;
+    in >> magic >> version >> storedRoot >> fileCount;
+    if (in.status() != QDataStream::Ok || magic != IndexMagic || version != IndexVersion
+            || storedRoot != root || fileCount < 0) {
+        return false;
+    }
+
+    // Read into fresh containers and swapped in at the end, so searches are not held up
+    QVector<FileEntry> loadedFiles;
+    QHash<QString, int> loadedFileIds;
+    QHash<QString, QVector<int>> loadedLinkSources;
+    QDir rootDir(root);
+    loadedFiles.reserve(fileCount);
+    for (qint32 i = 0; i < fileCount; ++i) {
+        FileEntry entry;
+        QString relativePath;
+        QStringList relativeLinks;
+        in >> relativePath >> entry.modified >> entry.size >> entry.anchors >> relativeLinks;
+        entry.filePath = rootDir.filePath(relativePath);
+        for (const QString &link : std::as_const(relativeLinks)) {
+            QString target = QDir::cleanPath(rootDir.filePath(link));
+            entry.links.append(target);
+            loadedLinkSources[target].append(i);
+        }
+        loadedFileIds.insert(entry.filePath, i);
+        loadedFiles.append(entry);
+    }
+
+    qint32 termCount = 0;
+    in >> termCount;
+    if (in.status() != QDataStream::Ok || termCount < 0) {
+        return false;
+    }
+
+    QVector<QString> loadedTerms;
+    QHash<QString, int> loadedTermIds;
+    QVector<QVector<Posting>> loadedPostings;
+    loadedTerms.reserve(termCount);
+    loadedPostings.reserve(termCount);
+    for (qint32 term = 0; term < termCount; ++term) {
+        QString spelling;
+        qint32 count = 0;
+        in >> spelling >> count;
+        if (in.status() != QDataStream::Ok || count < 0) {
+            return false;
+        }
+
+        QVector<Posting> list;
+        list.reserve(count);
+        for (qint32 i = 0; i < count; ++i) {
+            qint32 fileId = 0;
+            qint32 occurrences = 0;
+            in >> fileId >> occurrences;
+            if (fileId < 0 || fileId >= fileCount) {
+                return false;
+            }
+            list.append(Posting{fileId, occurrences});
+            loadedFiles[fileId].terms.append(term);
+        }
+
+        loadedTerms.append(spelling);
+        loadedTermIds.insert(spelling, term);
+        loadedPostings.append(list);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    {
+        QWriteLocker locker(&lock);
+        files.swap(loadedFiles);
+        fileIds.swap(loadedFileIds);
+        terms.swap(loadedTerms);
+        termIds.swap(loadedTermIds);
+        postings.swap(loadedPostings);
+        linkSources.swap(loadedLinkSources);
+        sortedTerms.clear();
+        liveFiles = fileCount;
+    }
+    sortTerms();
+    return true;
+}
+
+void WorkspaceIndexer::saveIndex(const QString &root) const
+{
+    QString path = indexPath(root);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    QReadLocker locker(&lock);
+
+    // Removed files leave empty slots; the saved ids are dense
+    QVector<qint32> savedIds(files.size(), -1);
+    qint32 fileCount = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        if (!files[i].filePath.isEmpty()) {
+            savedIds[i] = fileCount++;
+        }
+    }
+
+    QDir rootDir(root);
+    out << IndexMagic << IndexVersion << root << fileCount;
+    for (const FileEntry &entry : files) {
+        if (!entry.filePath.isEmpty()) {
+            QStringList relativeLinks;
+            for (const QString &target : entry.links) {
+                relativeLinks.append(rootDir.relativeFilePath(target));
+            }
+            out << rootDir.relativeFilePath(entry.filePath) << entry.modified << entry.size
+                << entry.anchors << relativeLinks;
+        }
+    }
+
+    qint32 termCount = 0;
+    for (const QVector<Posting> &list : postings) {
+        if (!list.isEmpty()) {
+            termCount++;
+        }
+    }
+    out << termCount;
+    for (int term = 0; term < terms.size(); ++term) {
+        const QVector<Posting> &list = postings[term];
+        if (list.isEmpty()) {
+            continue;
+        }
+        out << terms[term] << qint32(list.size());
+        for (const Posting &posting : list) {
+            out << savedIds[posting.file] << qint32(posting.count);
+        }
+    }
+    locker.unlock();
+
+    file.commit();
+}
+
+QString WorkspaceIndexer::indexPath(const QString &root)
+{
+    QByteArray key = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/workspace-index/" + QString::fromLatin1(key) + ".index";
+}
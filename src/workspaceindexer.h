@@ -0,0 +1,137 @@
+#ifndef WORKSPACEINDEXER_H
+#define WORKSPACEINDEXER_H
+
+#include <QObject>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include <memory>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Full-text index of the markdown files under a folder. The folder is walked
+// on a worker thread; files whose mtime and size are unchanged since the last
+// walk are not read again. The index maps every word to the files containing
+// it and is kept in the cache directory, so reopening a folder only reads the
+// files that changed meanwhile. Searches run on the caller's thread against
+// the in-memory index and do not touch the disk. Links between the files
+// and their heading anchors are kept as well, for backlinks and link checks.
+class WorkspaceIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Match
+    {
+        QString filePath;
+        int hits = 0;  // occurrences of the query words
+    };
+
+    explicit WorkspaceIndexer(QObject *parent = nullptr);
+    ~WorkspaceIndexer();
+
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+
+    // Ignored folders such as node_modules are not indexed; .gitignore files
+    // are followed, plus these patterns in the same syntax
+    void setIgnorePatterns(const QStringList &patterns);
+
+    // Walks the folder again, reading only files that changed
+    void rescan();
+    // Lists just the given folders again; files in folders new since the
+    // last scan are picked up as well
+    void rescanDirectories(const QStringList &directories);
+    // Re-reads a single file, e.g. after it was saved
+    void updateFile(const QString &filePath);
+
+    // Files containing every word of the query, most hits first. The last
+    // word also matches as a prefix, so results follow typing.
+    QVector<Match> search(const QString &query, int maxResults = 200) const;
+
+    // Indexed files linking to filePath, sorted
+    QStringList backlinks(const QString &filePath) const;
+    // Heading anchors of an indexed file; false if the file is not indexed
+    bool anchors(const QString &filePath, QStringList *anchors) const;
+
+    bool isIndexing() const;
+    int fileCount() const;
+
+signals:
+    void indexingProgress(int filesIndexed);
+    void indexingFinished(int fileCount);
+
+private:
+    struct ScanJob;
+
+    struct FileEntry
+    {
+        QString filePath;  // empty once the file is removed
+        qint64 modified = 0;
+        qint64 size = 0;
+        QVector<int> terms;
+        QStringList anchors;
+        QStringList links;  // resolved paths of the local files it links to
+    };
+
+    struct Posting
+    {
+        int file;
+        int count;
+    };
+
+    struct Update
+    {
+        QString filePath;
+        qint64 modified = 0;
+        qint64 size = 0;
+        QHash<QString, int> terms;
+        QStringList anchors;
+        QStringList links;
+    };
+
+    void startScan(bool reset);
+    void scan(std::shared_ptr<ScanJob> job);
+    void scanDirectories(std::shared_ptr<ScanJob> job);
+    void onScanFinished(std::shared_ptr<ScanJob> job, const QStringList &directories);
+    bool readFile(const QString &filePath, qint64 modified, qint64 size, Update *update) const;
+
+    // Called on the worker thread with the lock held for writing
+    void applyUpdate(const Update &update);
+    void dropPostings(int file);
+    void addLinkSources(int file);
+    void removeFile(int file);
+    void clearIndex();
+
+    void sortTerms();
+    bool loadIndex(const QString &root);
+    void saveIndex(const QString &root) const;
+    static QString indexPath(const QString &root);
+
+    QString root;
+    QStringList ignorePatterns;
+    std::shared_ptr<ScanJob> scanJob;
+    QThreadPool pool;  // One worker, so scans and updates apply in order
+    QFileSystemWatcher *directoryWatcher;
+    QTimer *rescanTimer;
+    QSet<QString> changedDirectories;  // Reported by the watcher since the last rescan
+    qint64 lastScanStarted;  // ms since the epoch
+
+    // Shared with the worker; searches take the lock for reading
+    mutable QReadWriteLock lock;
+    QVector<FileEntry> files;
+    QHash<QString, int> fileIds;
+    QVector<QString> terms;
+    QHash<QString, int> termIds;
+    QVector<QVector<Posting>> postings;  // per term
+    QVector<int> sortedTerms;  // term ids by spelling, for prefix search; newer terms follow unsorted
+    QHash<QString, QVector<int>> linkSources;  // link target -> files linking to it
+    int liveFiles;
+};
+
+#endif // WORKSPACEINDEXER_H